@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2026 ardupilot_sitl_gazebo contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef GAZEBO_PLUGINS_ARDUPILOTHISTOGRAM_HH_
+#define GAZEBO_PLUGINS_ARDUPILOTHISTOGRAM_HH_
+
+#include <algorithm>
+#include <cstdint>
+
+namespace gazebo
+{
+  /// \brief Fixed size histogram of non-negative integers with buckets
+  /// growing logarithmically (HDR style).
+  ///
+  /// Values below 2^kSubBits get a bucket each, above that every power of
+  /// two is split into 2^kSubBits linear buckets, so any recorded value is
+  /// known to within 1/2^kSubBits of itself. Add() is a handful of integer
+  /// instructions and never allocates, the histogram can stay enabled on
+  /// every physics step.
+  class LogHistogram
+  {
+    /// \brief Linear buckets per power of two, as a bit count
+    public: static const int kSubBits = 4;
+
+    /// \brief Linear buckets per power of two
+    public: static const uint64_t kSubCount = 1u << kSubBits;
+
+    /// \brief Number of buckets covering the whole uint64_t range
+    public: static const int kBuckets = (64 - kSubBits + 1) << kSubBits;
+
+    /// \brief Record a value.
+    /// \param[in] _value Value, e.g. nanoseconds.
+    public: void Add(const uint64_t _value)
+    {
+      ++this->counts[Bucket(_value)];
+      ++this->count;
+      this->sum += _value;
+      this->max = std::max(this->max, _value);
+    }
+
+    /// \brief Forget every recorded value.
+    public: void Reset()
+    {
+      std::fill(this->counts, this->counts + kBuckets, 0u);
+      this->count = 0;
+      this->sum = 0;
+      this->max = 0;
+    }
+
+    /// \brief Number of recorded values.
+    /// \return Count since construction or the last Reset().
+    public: uint64_t Count() const
+    {
+      return this->count;
+    }
+
+    /// \brief Mean of the recorded values.
+    /// \return Mean, 0 if nothing was recorded.
+    public: double Mean() const
+    {
+      return this->count > 0 ?
+        static_cast<double>(this->sum) / this->count : 0.0;
+    }
+
+    /// \brief Largest recorded value.
+    /// \return Exact maximum, 0 if nothing was recorded.
+    public: uint64_t Max() const
+    {
+      return this->max;
+    }
+
+    /// \brief Value below which a fraction of the recorded values fall.
+    /// \param[in] _fraction Fraction in [0, 1], e.g. 0.99.
+    /// \return Upper bound of the bucket holding that value, capped at
+    /// Max(). 0 if nothing was recorded.
+    public: uint64_t Percentile(const double _fraction) const
+    {
+      const double clamped = std::max(0.0, std::min(_fraction, 1.0));
+      const uint64_t rank = std::max<uint64_t>(1,
+          static_cast<uint64_t>(clamped * this->count + 0.5));
+      uint64_t seen = 0;
+      for (int i = 0; i < kBuckets && this->count > 0; ++i)
+      {
+        seen += this->counts[i];
+        if (seen >= rank)
+        {
+          return std::min(UpperBound(i), this->max);
+        }
+      }
+      return this->max;
+    }
+
+    /// \brief Bucket of a value.
+    /// \param[in] _value Value.
+    /// \return Bucket index.
+    private: static int Bucket(const uint64_t _value)
+    {
+      if (_value < kSubCount)
+      {
+        return static_cast<int>(_value);
+      }
+      const int shift = HighestBit(_value) - kSubBits;
+      return ((shift + 1) << kSubBits) +
+        static_cast<int>((_value >> shift) & (kSubCount - 1));
+    }
+
+    /// \brief Largest value falling into a bucket.
+    /// \param[in] _bucket Bucket index.
+    /// \return Inclusive upper bound.
+    private: static uint64_t UpperBound(const int _bucket)
+    {
+      if (_bucket < static_cast<int>(kSubCount))
+      {
+        return static_cast<uint64_t>(_bucket);
+      }
+      const int shift = (_bucket >> kSubBits) - 1;
+      const uint64_t sub = static_cast<uint64_t>(_bucket) & (kSubCount - 1);
+      return (((kSubCount + sub + 1) << shift) - 1);
+    }
+
+    /// \brief Index of the highest set bit.
+    /// \param[in] _value Non zero value.
+    /// \return Bit index, 0 to 63.
+    private: static int HighestBit(const uint64_t _value)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+      return 63 - __builtin_clzll(_value);
+#else
+      int bit = 0;
+      for (uint64_t v = _value >> 1; v != 0; v >>= 1)
+      {
+        ++bit;
+      }
+      return bit;
+#endif
+    }
+
+    /// \brief Values per bucket
+    private: uint32_t counts[kBuckets] = {};
+
+    /// \brief Number of recorded values
+    private: uint64_t count = 0;
+
+    /// \brief Sum of the recorded values
+    private: uint64_t sum = 0;
+
+    /// \brief Largest recorded value
+    private: uint64_t max = 0;
+  };
+}
+#endif
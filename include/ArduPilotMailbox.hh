@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2026 ardupilot_sitl_gazebo contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef GAZEBO_PLUGINS_ARDUPILOTMAILBOX_HH_
+#define GAZEBO_PLUGINS_ARDUPILOTMAILBOX_HH_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace gazebo
+{
+  /// \brief Lock-free single-producer/single-consumer mailbox that only
+  /// keeps the newest value written (triple buffer).
+  ///
+  /// The producer fills WriteSlot() and calls Publish(), the consumer
+  /// calls Read() which returns the newest published value, or nullptr if
+  /// nothing new was published since the last Read(). Both sides are
+  /// wait-free and never copy the payload.
+  template <typename T>
+  class LatestValueMailbox
+  {
+    /// \brief Slot the producer may write into before calling Publish().
+    /// \return Reference to the producer's private slot.
+    public: T &WriteSlot()
+    {
+      return this->buffers[this->backIndex];
+    }
+
+    /// \brief Publish the producer slot, making it the newest value.
+    public: void Publish()
+    {
+      const uint8_t prev = this->middle.exchange(
+          static_cast<uint8_t>(this->backIndex | kDirty),
+          std::memory_order_acq_rel);
+      this->backIndex = prev & kIndexMask;
+    }
+
+    /// \brief Fetch the newest published value.
+    /// \return Pointer to the value, valid until the next Read(), or
+    /// nullptr if no new value was published.
+    public: const T *Read()
+    {
+      if (!(this->middle.load(std::memory_order_relaxed) & kDirty))
+      {
+        return nullptr;
+      }
+      const uint8_t prev = this->middle.exchange(this->frontIndex,
+          std::memory_order_acq_rel);
+      this->frontIndex = prev & kIndexMask;
+      return &this->buffers[this->frontIndex];
+    }
+
+    /// \brief Flag marking the middle slot as unread
+    private: static const uint8_t kDirty = 0x4;
+
+    /// \brief Mask extracting a slot index
+    private: static const uint8_t kIndexMask = 0x3;
+
+    /// \brief The three buffers
+    private: T buffers[3];
+
+    /// \brief Slot owned by the producer
+    private: uint8_t backIndex = 0;
+
+    /// \brief Shared slot index, plus dirty flag
+    private: std::atomic<uint8_t> middle{1};
+
+    /// \brief Slot owned by the consumer
+    private: uint8_t frontIndex = 2;
+  };
+
+  /// \brief Bounded lock-free single-producer/single-consumer FIFO.
+  /// \tparam T Element type.
+  /// \tparam N Capacity, must be a power of two.
+  template <typename T, size_t N>
+  class SpscQueue
+  {
+    static_assert((N & (N - 1)) == 0, "SpscQueue capacity must be 2^n");
+
+    /// \brief Slot the producer may fill before calling Push().
+    /// \return Pointer to the slot, or nullptr if the queue is full.
+    public: T *WriteSlot()
+    {
+      const size_t pos = this->tail.load(std::memory_order_relaxed);
+      if (pos - this->head.load(std::memory_order_acquire) == N)
+      {
+        return nullptr;
+      }
+      return &this->items[pos & (N - 1)];
+    }
+
+    /// \brief Commit the slot returned by WriteSlot().
+    public: void Push()
+    {
+      this->tail.fetch_add(1, std::memory_order_release);
+    }
+
+    /// \brief Oldest element in the queue.
+    /// \return Pointer to the element, or nullptr if the queue is empty.
+    public: const T *Front() const
+    {
+      const size_t pos = this->head.load(std::memory_order_relaxed);
+      if (pos == this->tail.load(std::memory_order_acquire))
+      {
+        return nullptr;
+      }
+      return &this->items[pos & (N - 1)];
+    }
+
+    /// \brief Release the element returned by Front().
+    public: void Pop()
+    {
+      this->head.fetch_add(1, std::memory_order_release);
+    }
+
+    /// \brief True if the queue holds no element.
+    public: bool Empty() const
+    {
+      return this->head.load(std::memory_order_acquire) ==
+        this->tail.load(std::memory_order_acquire);
+    }
+
+    /// \brief Element storage
+    private: T items[N];
+
+    /// \brief Consumer position
+    private: std::atomic<size_t> head{0};
+
+    /// \brief Keep head and tail on separate cache lines. Padding rather
+    /// than alignas, so heap allocation works without C++17 aligned new.
+    private: char pad[64 - sizeof(std::atomic<size_t>)];
+
+    /// \brief Producer position
+    private: std::atomic<size_t> tail{0};
+  };
+}
+#endif
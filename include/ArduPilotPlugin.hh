@@ -24,7 +24,6 @@
 namespace gazebo
 {
   // Forward declare private data class
-  class ArduPilotSocketPrivate;
   class ArduPilotPluginPrivate;
 
   /// \brief Interface ArduPilot from ardupilot stack
@@ -36,7 +35,31 @@ namespace gazebo
   ///    channel            attribute, ardupilot control channel
   ///    multiplier         command multiplier
   ///    <!-- output to Gazebo -->
-  ///    type               type of control, VELOCITY, POSITION or EFFORT
+  ///    type               type of control, VELOCITY, POSITION, EFFORT,
+  ///                       MOTOR or WRENCH. MOTOR takes the command as
+  ///                       the steady state rotor speed of a first order
+  ///                       motor/ESC lag, updated in closed form and set
+  ///                       as joint velocity, no PID
+  ///    motorTimeConstant  MOTOR lag time constant in seconds, default 0.02
+  ///    motorTimeConstantUp, motorTimeConstantDown
+  ///                       MOTOR time constants while spinning up and
+  ///                       down, default motorTimeConstant
+  ///    kinematicSpin      if true, a MOTOR rotor is rigid for physics: no
+  ///                       joint is driven, thrust thrustCoefficient * w^2
+  ///                       along the rotor axis and drag torque
+  ///                       torqueCoefficient * w^2 are applied to linkName
+  ///                       and visualName only spins visually
+  ///    linkName           link carrying a kinematicSpin rotor
+  ///    visualName         visual of linkName spun about its z axis
+  ///    rotorPose          rotor pose in the link frame, thrust along its
+  ///                       z axis, default the pose of visualName
+  ///    thrustCoefficient  N / (rad/s)^2
+  ///    torqueCoefficient  N m / (rad/s)^2
+  ///    wrench             WRENCH mixer column "fx fy fz tx ty tz" in the
+  ///                       frame of linkName. The columns of all WRENCH
+  ///                       controls, scaled by their commands, are summed
+  ///                       and applied to the link, no joint or PID
+  ///    linkName           link a WRENCH acts on, default canonical link
   ///    <p_gain>           velocity pid p gain
   ///    <i_gain>           velocity pid i gain
   ///    <d_gain>           velocity pid d gain
@@ -46,12 +69,135 @@ namespace gazebo
   ///    <cmd_min>          velocity pid min command torque
   ///    <jointName>        motor joint, torque applied here
   ///    <turningDirection> rotor turning direction, 'cw' or 'ccw'
-  ///    frequencyCutoff    filter incoming joint state
+  ///    frequencyCutoff    low-pass cutoff in Hz on the joint state fed to
+  ///                       the PID, unfiltered if not set
   ///    samplingRate       sampling rate for filtering incoming joint state
   ///    <rotorVelocitySlowdownSim> for rotor aliasing problem, experimental
   /// <imuName>     scoped name for the imu sensor
-  /// <connectionTimeoutMaxCount> timeout before giving up on
-  ///                             controller synchronization
+  /// <imuSource> 'sensor' (default) read the imuName sensor, or 'link'
+  ///               compute specific force and body rates from the world
+  ///               kinematics of imuLinkName on the physics thread, with
+  ///               no IMU sensor needed
+  /// <imuLinkName> link for imuSource 'link', in whose frame the IMU
+  ///               reads, default canonical link
+  /// <imuGyroNoise>, <imuAccelNoise> white noise standard deviations
+  ///               for imuSource 'link', rad/s and m/s^2, default 0
+  /// <imuGyroBiasRandomWalk>, <imuAccelBiasRandomWalk> bias random walk
+  ///               for imuSource 'link', per sqrt(s), default 0
+  /// <spinVisualRate> sim time rate in Hz at which kinematicSpin rotor
+  ///               visuals are posed, 0 to leave them still, default 30
+  /// <statsRate> sim time rate in Hz at which receive wait,
+  ///               ApplyMotorForces and SendState timings, drained
+  ///               packets and timeouts are published as text on
+  ///               ~/<model>/ardupilot_stats, 0 to only log them on
+  ///               shutdown, default 1
+  /// <connectionTimeoutMaxCount> consecutive maxTimeoutMs timeouts before
+  ///                             giving up on controller synchronization
+  /// <timeoutSigma> the receive timeout is the smoothed ArduPilot reply
+  ///                interval plus this many mean deviations, doubled on
+  ///                each consecutive miss, default 4
+  /// <minTimeoutMs> lower bound of the receive timeout, default 1
+  /// <maxTimeoutMs> upper bound of the receive timeout, default 1000
+  /// <frameNumbers> if true, servo and state packets are prefixed with
+  ///               {uint32 magic "APFN", uint32 frame number}. The state
+  ///               packet echoes the number of the servo frame it answers,
+  ///               lost, duplicated and reordered frames and ArduPilot
+  ///               restarts are counted and printed on unload. Unnumbered
+  ///               servo packets are still accepted, default false
+  /// <protocol>  'legacy' (default) fixed fdmPacket of doubles and servo
+  ///               packets of up to 255 floats
+  ///               'v2' state packets start with a header carrying a
+  ///                 version, the frame number, a field mask and the
+  ///                 servo channel count the model expects, followed by
+  ///                 the timestamp and the masked fields. Servo packets
+  ///                 are {uint32 magic "APC2", uint32 frame number} and
+  ///                 one float per channel
+  /// <stateFields> v2 fields to send, any of imu attitude velocity
+  ///               position gps airspeed battery rangefinder baro
+  ///               proximity, default imu attitude velocity position and
+  ///               gps, rangefinder, baro, proximity if the model has
+  ///               them
+  /// <stateEncoding> 'double' (default) or 'float32' for v2 fields, gps
+  ///               and timestamp are always double
+  /// <gpsName>     gps sensor reported with v2, default gps_sensor
+  /// <rangefinderName> ray sensor reported with v2, default
+  ///               rangefinder_sensor
+  /// <baroName>    altimeter sensor reported with v2, default baro_sensor
+  /// <rayRangefinder> rangefinder measured with a physics ray query on
+  ///               the physics thread, reported with v2 instead of
+  ///               rangefinderName
+  ///    <link>     link the sensor is fixed to, default canonical link
+  ///    <pose>     sensor pose in the link frame, the beam points along
+  ///               its x axis, e.g. 0 0 0 0 1.5708 0 for downward
+  ///    <minRange> beam start distance from the sensor origin, should
+  ///               clear the vehicle's own collisions, default 0.1
+  ///    <maxRange> default 10
+  /// <rayProximity> ring of physics ray beams reported with v2 as the
+  ///               proximity field, -1 where nothing is in range. May be
+  ///               repeated, up to 72 beams in total
+  ///    <link>, <pose>, <minRange>, <maxRange> as for rayRangefinder
+  ///    <beams>    number of beams, default 8
+  ///    <minAngle>, <maxAngle> beam fan about the sensor z axis, a
+  ///               full turn by default
+  ///               Sensors are looked up once at load and only read when
+  ///               their last update time has advanced
+  /// <syncMode>  'lockstep' (default) wait for a servo packet on every
+  ///               physics step, or 'async' keep stepping and sending
+  ///               state with the last command, and only wait once the
+  ///               command is older than maxStaleness. Staleness
+  ///               statistics are printed on unload
+  /// <maxStaleness> largest command age in sim seconds for 'async',
+  ///               default 0.02
+  /// <physicsStepsPerFrame> physics steps per ArduPilot exchange. The
+  ///               servo command is held over the sub-steps and the state
+  ///               sent at the end of the frame carries the IMU readings
+  ///               averaged over them, default 1
+  /// <lockstepBarrier> if true, every vehicle of the world enabling it
+  ///               is stepped by one coordinator that waits for all their
+  ///               servo packets at once, each with its own timeout,
+  ///               before applying any. Only the socket transports
+  ///               (udp, unix, unix_seqpacket) are waited on together,
+  ///               shm, mux and inprocess vehicles wait in their own
+  ///               step, default false
+  /// <startupMode> behaviour before ArduPilot first connects, one of
+  ///               'poll' (default) wait 1 ms on every physics step
+  ///               'free_run' never wait, physics runs at full speed
+  ///               'block' wait up to maxTimeoutMs on every physics step
+  ///               'pause' pause the world and resume it once every
+  ///                 vehicle in this mode got its first servo packet, no
+  ///                 per-step polling
+  /// <transport>   packet transport to ArduPilot, one of
+  ///               'udp' (default) IPv4 listen_addr:fdm_port_in and
+  ///                 fdm_addr:fdm_port_out
+  ///               'unix' or 'unix_seqpacket' unix sockets at the paths
+  ///                 listen_addr and fdm_addr, '@' prefix for abstract
+  ///                 names, default @ardupilot_gazebo_<fdm_port_in> and
+  ///                 @ardupilot_sitl_<fdm_port_out>
+  ///               'shm' shared memory segment on the same host
+  ///               'mux' one UDP socket at listen_addr:fdm_port_in shared
+  ///                 by every vehicle of the world, packets are tagged
+  ///                 with vehicle_id and batched with sendmmsg/recvmmsg
+  ///               'inprocess' flight stack shared library called
+  ///                 synchronously from the physics step
+  /// <sitl_library> library for the 'inprocess' transport, default
+  ///               libArduPilotSITL.so, see ArduPilotSitlLibrary.hh
+  /// <sitl_args>   instance arguments passed to ap_sitl_create()
+  /// <shm_name>    shared memory segment name for the 'shm' transport,
+  ///               default /ardupilot_gazebo_<fdm_port_in>
+  /// <vehicle_id>  vehicle id for the 'mux' transport, unique per world,
+  ///               0 to 65535
+  /// <ioThread>    if true, socket I/O runs on a dedicated thread and the
+  ///               physics step only exchanges packets with it through
+  ///               lock-free mailboxes, default false
+  /// <ioThreadCpu> CPU to pin the I/O thread to, default none
+  /// <physicsThreadCpu> CPU to pin the physics thread to, default none
+  /// <recvSpinUs>  microseconds to busy-poll for a servo packet before
+  ///               blocking, default 0. The spin/block split is printed
+  ///               when the plugin unloads
+  /// <busyPollUs>  SO_BUSY_POLL on the receive socket (Linux), default 0
+  /// <socketRecvBufferSize> SO_RCVBUF in bytes, default system
+  /// <socketSendBufferSize> SO_SNDBUF in bytes, default system
+  /// <socketPriority> SO_PRIORITY of the sockets (Linux), default system
   class GAZEBO_VISIBLE ArduPilotPlugin : public ModelPlugin
   {
     /// \brief Constructor.
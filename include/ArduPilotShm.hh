@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2026 ardupilot_sitl_gazebo contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef GAZEBO_PLUGINS_ARDUPILOTSHM_HH_
+#define GAZEBO_PLUGINS_ARDUPILOTSHM_HH_
+
+#include <sys/types.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "include/ArduPilotTransport.hh"
+
+namespace gazebo
+{
+  // Forward declare shared segment layout
+  struct ArduPilotShmSegment;
+
+  /// \brief Same-host lockstep transport through a POSIX shared memory
+  /// segment.
+  ///
+  /// The segment holds two single-writer slots, one carrying servo
+  /// packets from ArduPilot to Gazebo and one carrying state packets
+  /// from Gazebo to ArduPilot. Each slot is guarded by a sequence counter
+  /// (seqlock) which doubles as a futex word, so a blocked reader is
+  /// woken directly by the writer without any socket in between.
+  ///
+  /// The Gazebo side creates the segment, the ArduPilot side opens it,
+  /// see ArduPilotShmPeer.hh for the C interface used by SITL.
+  class ArduPilotShm
+  {
+    /// \brief Largest packet a slot can carry
+    public: static const size_t kSlotCapacity = 2048;
+
+    /// \brief Constructor
+    public: ArduPilotShm();
+
+    /// \brief Destructor, unmaps the segment and unlinks it if created.
+    public: ~ArduPilotShm();
+
+    /// \brief Create the segment, replacing any stale one of the same name.
+    /// Fails if a segment of that name is still owned by a running
+    /// process, or is still being set up by its creator.
+    /// \param[in] _name POSIX shared memory name, e.g. "/ardupilot_9002".
+    /// \return True on success.
+    public: bool Create(const std::string &_name);
+
+    /// \brief Open a segment created by the simulator.
+    /// \param[in] _name POSIX shared memory name.
+    /// \return True on success.
+    public: bool Open(const std::string &_name);
+
+    /// \brief Publish a packet on this end's outgoing slot and wake the
+    /// peer if it is waiting.
+    /// \param[in] _buf Packet data.
+    /// \param[in] _size Packet size, at most kSlotCapacity.
+    /// \return _size on success, -1 otherwise.
+    public: ssize_t Send(const void *_buf, const size_t _size);
+
+    /// \brief Wait for a packet newer than the last one read on this end's
+    /// incoming slot and copy it out.
+    /// \param[out] _buf Buffer that receives the packet.
+    /// \param[in] _size Size of the buffer.
+    /// \param[in] _timeoutMs Milliseconds to wait.
+    /// \param[out] _dropped Number of packets overwritten unread since
+    /// the previous receive.
+    /// \return Packet size, or -1 on timeout.
+    public: ssize_t RecvLatest(void *_buf, const size_t _size,
+        uint32_t _timeoutMs, uint32_t &_dropped);
+
+    /// \brief True once Create() or Open() succeeded.
+    public: bool IsOpen() const;
+
+    /// \brief Busy-poll the incoming slot this long before sleeping on
+    /// the futex.
+    /// \param[in] _spinUs Microseconds, 0 to block straight away.
+    public: void SetSpinBudget(const uint32_t _spinUs);
+
+    /// \brief Receive wait statistics.
+    /// \return Counters since construction.
+    public: ArduPilotWaitStats WaitStats() const;
+
+    /// \brief Map the segment.
+    /// \param[in] _name POSIX shared memory name.
+    /// \param[in] _create True to create, false to open.
+    /// \return True on success.
+    private: bool Map(const std::string &_name, const bool _create);
+
+    /// \brief Mapped segment
+    private: ArduPilotShmSegment *segment = nullptr;
+
+    /// \brief Segment name, non empty if this object must unlink it
+    private: std::string ownedName;
+
+    /// \brief Index of the slot this end writes to
+    private: int txSlot = 1;
+
+    /// \brief Index of the slot this end reads from
+    private: int rxSlot = 0;
+
+    /// \brief Last sequence number read from the incoming slot
+    private: uint32_t rxSeq = 0;
+
+    /// \brief Busy-poll budget in microseconds
+    private: uint32_t spinUs = 0;
+
+    /// \brief Receive wait statistics
+    private: ArduPilotWaitStats stats;
+  };
+}
+#endif
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2026 ardupilot_sitl_gazebo contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef GAZEBO_PLUGINS_ARDUPILOTSHMPEER_HH_
+#define GAZEBO_PLUGINS_ARDUPILOTSHMPEER_HH_
+
+/// \file
+/// \brief C interface to the shared memory transport for the ArduPilot
+/// SITL side, see ArduPilotShm.hh. Link against libArduPilotShmPeer.
+///
+/// Typical lockstep loop:
+///   ap_shm_peer *peer = ap_shm_peer_open("/ardupilot_9002");
+///   while (running)
+///   {
+///     ap_shm_peer_send_servo(peer, servos, sizeof(servos));
+///     ap_shm_peer_recv_state(peer, &fdm, sizeof(fdm), 1000);
+///   }
+///   ap_shm_peer_close(peer);
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+  #define AP_SHM_PEER_VISIBLE __attribute__((visibility("default")))
+#else
+  #define AP_SHM_PEER_VISIBLE
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// \brief Opaque peer handle
+typedef struct ap_shm_peer ap_shm_peer;
+
+/// \brief Attach to a segment created by ArduPilotPlugin.
+/// \param[in] _name POSIX shared memory name, see <shm_name>.
+/// \return Peer handle, or NULL if the segment does not exist yet.
+AP_SHM_PEER_VISIBLE ap_shm_peer *ap_shm_peer_open(const char *_name);
+
+/// \brief Detach from the segment and free the handle.
+/// \param[in] _peer Peer handle.
+AP_SHM_PEER_VISIBLE void ap_shm_peer_close(ap_shm_peer *_peer);
+
+/// \brief Publish a servo packet to Gazebo.
+/// \param[in] _peer Peer handle.
+/// \param[in] _buf Packet data.
+/// \param[in] _size Packet size in bytes.
+/// \return _size on success, -1 otherwise.
+AP_SHM_PEER_VISIBLE int ap_shm_peer_send_servo(ap_shm_peer *_peer,
+    const void *_buf, size_t _size);
+
+/// \brief Wait for the next state packet from Gazebo.
+/// \param[in] _peer Peer handle.
+/// \param[out] _buf Buffer that receives the packet.
+/// \param[in] _size Size of the buffer.
+/// \param[in] _timeoutMs Milliseconds to wait.
+/// \return Packet size, or -1 on timeout.
+AP_SHM_PEER_VISIBLE int ap_shm_peer_recv_state(ap_shm_peer *_peer,
+    void *_buf, size_t _size, uint32_t _timeoutMs);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
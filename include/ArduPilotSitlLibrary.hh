@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2026 ardupilot_sitl_gazebo contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef GAZEBO_PLUGINS_ARDUPILOTSITLLIBRARY_HH_
+#define GAZEBO_PLUGINS_ARDUPILOTSITLLIBRARY_HH_
+
+/// \file
+/// \brief C interface a flight stack exports to run inside the Gazebo
+/// process, selected with <transport>inprocess</transport>.
+///
+/// The plugin dlopen()s the library and calls ap_sitl_step()
+/// synchronously from the physics step. State and servo packets have the
+/// same layout as on the wire, so <protocol> and <frameNumbers> apply
+/// unchanged. Each vehicle gets its own ap_sitl instance from
+/// ap_sitl_create(), instances of one library share its globals.
+///
+/// Call sequence made by the plugin:
+///   ap_sitl_abi_version() == AP_SITL_ABI_VERSION
+///   sitl = ap_sitl_create(args);
+///   ap_sitl_step(sitl, NULL, 0, servo, sizeof(servo));   // first command
+///   while (running)
+///   {
+///     ap_sitl_step(sitl, &state, sizeof(state), servo, sizeof(servo));
+///   }
+///   ap_sitl_destroy(sitl);
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+  #define AP_SITL_VISIBLE __attribute__((visibility("default")))
+#else
+  #define AP_SITL_VISIBLE
+#endif
+
+/// \brief Version of this interface, bumped on any incompatible change
+#define AP_SITL_ABI_VERSION 1u
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// \brief Opaque flight stack instance
+typedef struct ap_sitl ap_sitl;
+
+/// \brief Interface version the library was built against.
+/// \return AP_SITL_ABI_VERSION.
+AP_SITL_VISIBLE uint32_t ap_sitl_abi_version(void);
+
+/// \brief Create a flight stack instance.
+/// \param[in] _args Instance arguments, see <sitl_args>.
+/// \return Instance, or NULL on failure.
+AP_SITL_VISIBLE ap_sitl *ap_sitl_create(const char *_args);
+
+/// \brief Advance the flight stack with a new state and fetch its servo
+/// outputs.
+/// \param[in] _sitl Instance.
+/// \param[in] _state State packet, NULL before the first physics step.
+/// \param[in] _stateSize State packet size in bytes.
+/// \param[out] _servo Buffer receiving the servo packet.
+/// \param[in] _servoSize Size of the buffer.
+/// \return Servo packet size, or -1 if no command is available.
+AP_SITL_VISIBLE int ap_sitl_step(ap_sitl *_sitl, const void *_state,
+    size_t _stateSize, void *_servo, size_t _servoSize);
+
+/// \brief Destroy an instance.
+/// \param[in] _sitl Instance.
+AP_SITL_VISIBLE void ap_sitl_destroy(ap_sitl *_sitl);
+
+/// \brief Function pointer types, for dlsym()
+typedef uint32_t (*ap_sitl_abi_version_fn)(void);
+typedef ap_sitl *(*ap_sitl_create_fn)(const char *);
+typedef int (*ap_sitl_step_fn)(ap_sitl *, const void *, size_t, void *,
+    size_t);
+typedef void (*ap_sitl_destroy_fn)(ap_sitl *);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
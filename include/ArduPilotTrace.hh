@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2026 ardupilot_sitl_gazebo contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef GAZEBO_PLUGINS_ARDUPILOTTRACE_HH_
+#define GAZEBO_PLUGINS_ARDUPILOTTRACE_HH_
+
+/// \file
+/// \brief Scoped trace spans, compiled in with -DENABLE_TRACING=ON.
+///
+///   AP_TRACE_SCOPE("ArduPilotPlugin::OnUpdate");
+///
+/// records the wall time from that line to the end of the enclosing
+/// scope into a ring buffer owned by the calling thread. The newest
+/// kCapacity spans of every thread are written as Chrome trace JSON on
+/// exit, to the file named by the ARDUPILOT_GAZEBO_TRACE environment
+/// variable, default ardupilot_gazebo_trace.json. Open it in
+/// chrome://tracing or ui.perfetto.dev.
+///
+/// Without ARDUPILOT_GAZEBO_TRACING defined the macro expands to nothing.
+
+#ifdef ARDUPILOT_GAZEBO_TRACING
+
+#include <cstdint>
+#include <string>
+
+#include <gazebo/util/system.hh>
+
+namespace gazebo
+{
+  /// \brief Process wide collector of trace spans, shared by every plugin
+  /// linking ArduPilotTrace.
+  class GAZEBO_VISIBLE TraceRecorder
+  {
+    /// \brief Spans kept per thread, older ones are overwritten
+    public: static const uint32_t kCapacity = 1u << 16;
+
+    /// \brief Register a span name.
+    /// \param[in] _name Name, copied.
+    /// \return Identifier to pass to Record().
+    public: static uint32_t Intern(const char *_name);
+
+    /// \brief Monotonic wall clock.
+    /// \return Nanoseconds since an arbitrary epoch.
+    public: static uint64_t Now();
+
+    /// \brief Record a span into the calling thread's ring buffer.
+    /// Lock-free, takes a lock only the first time a thread records.
+    /// \param[in] _id Name identifier from Intern().
+    /// \param[in] _startNs Start time from Now().
+    /// \param[in] _endNs End time from Now().
+    public: static void Record(const uint32_t _id, const uint64_t _startNs,
+        const uint64_t _endNs);
+
+    /// \brief Write the recorded spans as Chrome trace JSON.
+    /// \param[in] _path Output file.
+    /// \return False if the file cannot be written.
+    public: static bool Write(const std::string &_path);
+  };
+
+  /// \brief Records a span from construction to destruction.
+  class TraceSpan
+  {
+    /// \brief Constructor, starts the span.
+    /// \param[in] _id Name identifier from TraceRecorder::Intern().
+    public: explicit TraceSpan(const uint32_t _id)
+      : id(_id), start(TraceRecorder::Now())
+    {
+    }
+
+    /// \brief Destructor, records the span.
+    public: ~TraceSpan()
+    {
+      TraceRecorder::Record(this->id, this->start, TraceRecorder::Now());
+    }
+
+    /// \brief Name identifier
+    private: const uint32_t id;
+
+    /// \brief Start time in ns
+    private: const uint64_t start;
+  };
+}
+
+#define AP_TRACE_CAT_(_a, _b) _a##_b
+#define AP_TRACE_CAT(_a, _b) AP_TRACE_CAT_(_a, _b)
+
+/// \brief Trace the rest of the enclosing scope under a literal name.
+#define AP_TRACE_SCOPE(_name) \
+  static const uint32_t AP_TRACE_CAT(apTraceId, __LINE__) = \
+    ::gazebo::TraceRecorder::Intern(_name); \
+  const ::gazebo::TraceSpan AP_TRACE_CAT(apTraceSpan, __LINE__)( \
+      AP_TRACE_CAT(apTraceId, __LINE__))
+
+#else
+
+#define AP_TRACE_SCOPE(_name)
+
+#endif
+#endif
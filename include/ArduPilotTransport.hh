@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2026 ardupilot_sitl_gazebo contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef GAZEBO_PLUGINS_ARDUPILOTTRANSPORT_HH_
+#define GAZEBO_PLUGINS_ARDUPILOTTRANSPORT_HH_
+
+#if defined(_MSC_VER)
+  #include <BaseTsd.h>
+  typedef SSIZE_T ssize_t;
+#else
+  #include <sys/types.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace gazebo
+{
+  /// \brief Wait policy and socket options of a transport.
+  /// Zero or negative values keep the system default.
+  struct ArduPilotTransportTuning
+  {
+    /// \brief Microseconds to busy-poll for a packet before blocking
+    uint32_t spinUs = 0;
+
+    /// \brief SO_BUSY_POLL microseconds on the receiving socket (Linux)
+    int busyPollUs = 0;
+
+    /// \brief SO_RCVBUF of the receiving socket
+    int recvBufferSize = 0;
+
+    /// \brief SO_SNDBUF of the sending socket
+    int sendBufferSize = 0;
+
+    /// \brief SO_PRIORITY of both sockets (Linux)
+    int priority = -1;
+  };
+
+  /// \brief How receive waits ended, to tune the spin budget.
+  struct ArduPilotWaitStats
+  {
+    /// \brief Packets found while busy-polling
+    uint64_t spinWakeups = 0;
+
+    /// \brief Packets found after blocking
+    uint64_t blockWakeups = 0;
+
+    /// \brief Waits with a non-zero timeout that expired
+    uint64_t timeouts = 0;
+  };
+
+  /// \brief Tells which of two received packets RecvLatest() keeps.
+  /// \param[in] _candidate Packet received later.
+  /// \param[in] _candidateSize Size of _candidate.
+  /// \param[in] _current Packet kept so far.
+  /// \param[in] _currentSize Size of _current.
+  /// \return True if _candidate is newer and replaces _current.
+  typedef bool (*ArduPilotPacketOrder)(const void *_candidate,
+      size_t _candidateSize, const void *_current, size_t _currentSize);
+
+  /// \brief Packet link between a plugin and an ArduPilot process.
+  ///
+  /// A link receives on a local address and sends to a remote address.
+  /// Backends are created with Create():
+  ///   udp             AF_INET datagrams, addresses are IPv4 + port
+  ///   unix            AF_UNIX SOCK_DGRAM, addresses are socket paths
+  ///   unix_seqpacket  AF_UNIX SOCK_SEQPACKET, addresses are socket paths
+  ///   shm             shared memory segment, see ArduPilotShm
+  ///   mux             one UDP socket shared by every vehicle bound to the
+  ///                   same local address, packets carry a MuxHeader
+  ///                   {uint32 magic "APMX", uint16 vehicle id, uint16 0}
+  ///                   and are sent and received in batches with
+  ///                   sendmmsg/recvmmsg
+  ///   inprocess       flight stack shared library loaded with dlopen and
+  ///                   stepped synchronously from Send(), the local
+  ///                   address is the library path and the remote address
+  ///                   the instance arguments, see ArduPilotSitlLibrary.hh
+  /// For the unix backends a path starting with '@' names a socket in the
+  /// Linux abstract namespace, which needs no file system cleanup. Ports
+  /// are ignored by the unix and shm backends.
+  class ArduPilotTransport
+  {
+    /// \brief Destructor
+    public: virtual ~ArduPilotTransport() = default;
+
+    /// \brief Create a transport backend.
+    /// \param[in] _type One of udp, unix, unix_seqpacket, shm, mux,
+    /// inprocess.
+    /// \param[in] _vehicleId Vehicle id tagged on mux packets, ignored by
+    /// the other backends.
+    /// \return The transport, or nullptr if _type is not recognized.
+    public: static std::unique_ptr<ArduPilotTransport> Create(
+        const std::string &_type, const uint16_t _vehicleId = 0);
+
+    /// \brief Start receiving on a local address.
+    /// \param[in] _address Local address, or shm segment name.
+    /// \param[in] _port Local port.
+    /// \return True on success.
+    public: virtual bool Bind(const std::string &_address,
+        const uint16_t _port) = 0;
+
+    /// \brief Set the destination of Send().
+    /// Unix socket backends keep retrying in Send() if the peer does not
+    /// exist yet.
+    /// \param[in] _address Remote address.
+    /// \param[in] _port Remote port.
+    /// \return True on success.
+    public: virtual bool Connect(const std::string &_address,
+        const uint16_t _port) = 0;
+
+    /// \brief Send a packet to the connected destination.
+    /// \param[in] _buf Packet data.
+    /// \param[in] _size Packet size.
+    /// \return Bytes sent, or -1 on error.
+    public: virtual ssize_t Send(const void *_buf, const size_t _size) = 0;
+
+    /// \brief Wait for data, then drain every queued packet and keep
+    /// only the newest one, see SetPacketOrder().
+    /// \param[out] _buf Buffer that receives the newest packet.
+    /// \param[in] _size Size of the buffer.
+    /// \param[in] _timeoutMs Milliseconds to wait for the first packet.
+    /// \param[out] _dropped Number of older packets discarded.
+    /// \param[in] _wakeFd Optional descriptor that interrupts the wait
+    /// when it becomes readable, -1 for none. Only honoured when
+    /// SupportsWakeFd() is true.
+    /// \return Size of the newest packet, or -1 if none was received.
+    public: virtual ssize_t RecvLatest(void *_buf, const size_t _size,
+        uint32_t _timeoutMs, uint32_t &_dropped, const int _wakeFd = -1) = 0;
+
+    /// \brief True if RecvLatest() can be interrupted through _wakeFd.
+    public: virtual bool SupportsWakeFd() const = 0;
+
+    /// \brief Descriptor that becomes readable when RecvLatest() has a
+    /// packet for this link, to wait on several links at once.
+    /// \return The descriptor, or -1 if the backend has none.
+    public: virtual int ReadableFd() const
+    {
+      return -1;
+    }
+
+    /// \brief Set the wait policy and socket options. Options a backend
+    /// has no use for are ignored.
+    /// \param[in] _tuning Options.
+    public: virtual void Configure(const ArduPilotTransportTuning &_tuning)
+    {
+      (void)_tuning;
+    }
+
+    /// \brief Receive wait statistics.
+    /// \return Counters since the transport was created.
+    public: virtual ArduPilotWaitStats WaitStats() const
+    {
+      return ArduPilotWaitStats();
+    }
+
+    /// \brief Decide which of the packets drained by one RecvLatest() is
+    /// the newest. By default it is the last one to arrive, a reordering
+    /// link needs the packet contents to tell.
+    /// \param[in] _order Comparison, nullptr for arrival order.
+    public: void SetPacketOrder(const ArduPilotPacketOrder _order)
+    {
+      this->packetOrder = _order;
+    }
+
+    /// \brief Comparison set by SetPacketOrder()
+    protected: ArduPilotPacketOrder packetOrder = nullptr;
+  };
+}
+#endif
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2026 ardupilot_sitl_gazebo contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef GAZEBO_PLUGINS_MULTIROTORAEROPLUGIN_HH_
+#define GAZEBO_PLUGINS_MULTIROTORAEROPLUGIN_HH_
+
+#include <memory>
+
+#include <sdf/sdf.hh>
+#include <gazebo/common/Plugin.hh>
+#include <gazebo/physics/physics.hh>
+#include <gazebo/util/system.hh>
+
+namespace gazebo
+{
+  // Forward declare private data class
+  class MultirotorAeroPluginPrivate;
+
+  /// \brief Propeller aerodynamics of every rotor of a multirotor, updated
+  /// in one pass per physics step.
+  ///
+  /// Thrust and drag torque come from a propeller performance map, thrust
+  /// and power coefficients against advance ratio J = V / (n D):
+  ///   T = CT(J) rho n^2 D^4,  Q = CP(J) rho n^2 D^5 / (2 pi)
+  /// with n the rotor speed in rev/s, D the diameter and V the hub
+  /// velocity along the thrust axis. Rotor drag, the in-plane force from
+  /// blade flapping and induced inflow, is -k |w| V_inplane. Forces and
+  /// the reaction torque are applied to the joint parent, the airframe.
+  ///
+  /// The plugin takes the following parameters:
+  /// <air_density>  kg/m^3, default 1.2041
+  /// <rotor_drag_coefficient> k above, N s / m / (rad/s), default 0
+  /// <rotor_velocity_slowdown_sim> joint speed to rotor speed factor,
+  ///                default 1
+  /// <propeller>    performance map shared by the rotors
+  ///    <diameter>  m
+  ///    <advance_ratio> increasing J samples
+  ///    <thrust_coefficient> CT at each J
+  ///    <power_coefficient>  CP at each J
+  /// <rotor>        one block per rotor
+  ///    <joint>     revolute rotor joint, its velocity is the rotor speed
+  ///    <direction> 'ccw' (default) if the propeller makes thrust along
+  ///                the joint axis when turning positively, 'cw' if
+  ///                when turning negatively
+  class GAZEBO_VISIBLE MultirotorAeroPlugin : public ModelPlugin
+  {
+    /// \brief Constructor.
+    public: MultirotorAeroPlugin();
+
+    /// \brief Destructor.
+    public: ~MultirotorAeroPlugin();
+
+    // Documentation Inherited.
+    public: virtual void Load(physics::ModelPtr _model, sdf::ElementPtr _sdf);
+
+    /// \brief Callback on world update, applies the rotor forces.
+    private: void OnUpdate();
+
+    /// \brief Private data pointer.
+    private: std::unique_ptr<MultirotorAeroPluginPrivate> dataPtr;
+  };
+}
+#endif
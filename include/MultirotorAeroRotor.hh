@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2026 ardupilot_sitl_gazebo contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef GAZEBO_PLUGINS_MULTIROTORAEROROTOR_HH_
+#define GAZEBO_PLUGINS_MULTIROTORAEROROTOR_HH_
+
+namespace gazebo
+{
+  /// \brief Side of the joint axis a rotor pushes toward.
+  ///
+  /// A propeller turning its intended way (positively for 'ccw',
+  /// negatively for 'cw') makes thrust along the joint axis, turning the
+  /// other way it pushes against it.
+  /// \param[in] _direction 1 for a 'ccw' rotor, -1 for a 'cw' rotor.
+  /// \param[in] _speed Rotor speed about the joint axis, rad/s.
+  /// \return 1 for thrust along the joint axis, -1 against it.
+  inline double RotorThrustSense(const double _direction,
+      const double _speed)
+  {
+    return _speed * _direction >= 0.0 ? 1.0 : -1.0;
+  }
+}
+#endif
@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2026 ardupilot_sitl_gazebo contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef GAZEBO_PLUGINS_WINDFIELDPLUGIN_HH_
+#define GAZEBO_PLUGINS_WINDFIELDPLUGIN_HH_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sdf/sdf.hh>
+#include <gazebo/common/Plugin.hh>
+#include <gazebo/physics/physics.hh>
+#include <gazebo/util/system.hh>
+
+namespace gazebo
+{
+  // Forward declare private data class
+  class WindFieldPluginPrivate;
+
+  /// \brief Wind velocity on a regular grid.
+  ///
+  /// Nodes are stored in 4x4x4 tiles, so the eight nodes of a trilinear
+  /// lookup are at most a few cache lines apart wherever the lookup
+  /// falls.
+  class GAZEBO_VISIBLE WindGrid
+  {
+    /// \brief Allocate the grid, all nodes zero.
+    /// \param[in] _nx Nodes along x.
+    /// \param[in] _ny Nodes along y.
+    /// \param[in] _nz Nodes along z.
+    /// \param[in] _origin Position of node (0, 0, 0).
+    /// \param[in] _spacing Distance between nodes along each axis.
+    public: void Resize(const int _nx, const int _ny, const int _nz,
+        const ignition::math::Vector3d &_origin,
+        const ignition::math::Vector3d &_spacing);
+
+    /// \brief Set a node.
+    /// \param[in] _i Node index along x.
+    /// \param[in] _j Node index along y.
+    /// \param[in] _k Node index along z.
+    /// \param[in] _v Wind velocity.
+    public: void Set(const int _i, const int _j, const int _k,
+        const ignition::math::Vector3d &_v);
+
+    /// \brief Get a node.
+    /// \param[in] _i Node index along x.
+    /// \param[in] _j Node index along y.
+    /// \param[in] _k Node index along z.
+    /// \return Wind velocity.
+    public: ignition::math::Vector3d Node(const int _i, const int _j,
+        const int _k) const;
+
+    /// \brief Trilinear lookup.
+    /// \param[in] _pos World position.
+    /// \param[in] _wrap True to repeat the grid periodically, false to
+    /// clamp to its bounds.
+    /// \return Wind velocity.
+    public: ignition::math::Vector3d Sample(
+        const ignition::math::Vector3d &_pos, const bool _wrap) const;
+
+    /// \brief True if the grid has no nodes.
+    public: bool Empty() const;
+
+    /// \brief Node counts along x, y and z
+    public: int size[3] = {0, 0, 0};
+
+    /// \brief Index of a node in data.
+    /// \param[in] _i Node index along x.
+    /// \param[in] _j Node index along y.
+    /// \param[in] _k Node index along z.
+    /// \return Index of the node's x component.
+    private: size_t Index(const int _i, const int _j, const int _k) const;
+
+    /// \brief Position of node (0, 0, 0)
+    private: ignition::math::Vector3d origin;
+
+    /// \brief Nodes per metre along each axis
+    private: ignition::math::Vector3d invSpacing;
+
+    /// \brief Tile counts along x and y
+    private: int tiles[2] = {0, 0};
+
+    /// \brief Tiled node velocities, x y z per node
+    private: std::vector<float> data;
+  };
+
+  /// \brief Mean wind plus frozen turbulence advected by the mean wind,
+  /// shared by every vehicle of a world.
+  class GAZEBO_VISIBLE WindField
+  {
+    /// \brief Wind velocity.
+    /// \param[in] _pos World position.
+    /// \param[in] _time Sim time in seconds.
+    /// \return Wind velocity in the world frame.
+    public: ignition::math::Vector3d Velocity(
+        const ignition::math::Vector3d &_pos, const double _time) const;
+
+    /// \brief Field of a world.
+    /// \param[in] _world World name.
+    /// \return The field, or nullptr if the world has no WindFieldPlugin.
+    public: static std::shared_ptr<const WindField> Find(
+        const std::string &_world);
+
+    /// \brief Mean wind
+    public: WindGrid mean;
+
+    /// \brief Turbulence, repeated periodically
+    public: WindGrid turbulence;
+
+    /// \brief Velocity the turbulence is carried with
+    public: ignition::math::Vector3d advection;
+  };
+
+  /// \brief World plugin building the WindField of its world.
+  ///
+  /// The mean wind follows a power law with height,
+  ///   v(z) = mean (z / reference_height)^shear_exponent,
+  /// or is read from a file. Turbulence is a periodic tile of smoothed
+  /// random velocities, carried along by the mean wind.
+  ///
+  /// <mean>             wind at reference_height, m/s, default 0 0 0
+  /// <reference_height> m, default 10
+  /// <shear_exponent>   default 0.14, 0 for no shear
+  /// <min>, <max>       grid bounds, default -500 -500 0 and 500 500 200
+  /// <spacing>          grid spacing in m, default 10
+  /// <file>             text file "nx ny nz ox oy oz dx dy dz" followed
+  ///                    by nx*ny*nz velocities, x fastest, replacing the
+  ///                    power law
+  /// <turbulence_intensity> standard deviation in m/s, default 0
+  /// <turbulence_scale> turbulence node spacing in m, default 20
+  /// <turbulence_size>  turbulence nodes per side, default 32
+  /// <seed>             turbulence random seed, default 1
+  class GAZEBO_VISIBLE WindFieldPlugin : public WorldPlugin
+  {
+    /// \brief Constructor.
+    public: WindFieldPlugin();
+
+    /// \brief Destructor.
+    public: ~WindFieldPlugin();
+
+    // Documentation Inherited.
+    public: virtual void Load(physics::WorldPtr _world, sdf::ElementPtr _sdf);
+
+    /// \brief Private data pointer.
+    private: std::unique_ptr<WindFieldPluginPrivate> dataPtr;
+  };
+}
+#endif
@@ -18,25 +18,6 @@
 #include <memory>
 #include <functional>
 
-#ifdef _WIN32
-  #include <Winsock2.h>
-  #include <Ws2def.h>
-  #include <Ws2ipdef.h>
-  #include <Ws2tcpip.h>
-  using raw_type = char;
-#else
-  #include <sys/socket.h>
-  #include <netinet/in.h>
-  #include <netinet/tcp.h>
-  #include <arpa/inet.h>
-  using raw_type = void;
-#endif
-
-#if defined(_MSC_VER)
-  #include <BaseTsd.h>
-  typedef SSIZE_T ssize_t;
-#endif
-
 #include <ignition/math/Angle.hh>
 #include <ignition/math/Vector3.hh>
 #include <ignition/math/Vector2.hh>
@@ -48,6 +29,8 @@
 #include <include/SelectionBuffer.hh>
 
 #include "include/ArduCopterIRLockPlugin.hh"
+#include "include/ArduPilotTrace.hh"
+#include "include/ArduPilotTransport.hh"
 
 using namespace gazebo;
 GZ_REGISTER_SENSOR_PLUGIN(ArduCopterIRLockPlugin)
@@ -74,7 +57,8 @@ namespace gazebo
     /// \brief Irlock port for receiver socket
     public: uint16_t irlock_port;
 
-    public: int handle;
+    /// \brief Link used to send irlock packets to ArduPilot
+    public: std::unique_ptr<ArduPilotTransport> transport;
 
     public: struct irlockPacket
             {
@@ -109,26 +93,6 @@ ArduCopterIRLockPlugin::ArduCopterIRLockPlugin()
     : SensorPlugin(),
       dataPtr(new ArduCopterIRLockPluginPrivate)
 {
-  // socket
-  this->dataPtr->handle = socket(AF_INET, SOCK_DGRAM /*SOCK_STREAM*/, 0);
-  #ifndef _WIN32
-  // Windows does not support FD_CLOEXEC
-  fcntl(this->dataPtr->handle, F_SETFD, FD_CLOEXEC);
-  #endif
-  int one = 1;
-  setsockopt(this->dataPtr->handle, IPPROTO_TCP, TCP_NODELAY,
-      reinterpret_cast<const char *>(&one), sizeof(one));
-  setsockopt(this->dataPtr->handle, SOL_SOCKET, SO_REUSEADDR,
-      reinterpret_cast<const char *>(&one), sizeof(one));
-
-  #ifdef _WIN32
-  u_long on = 1;
-  ioctlsocket(this->dataPtr->handle, FIONBIO,
-      reinterpret_cast<u_long FAR *>(&on));
-  #else
-  fcntl(this->dataPtr->handle, F_SETFL,
-      fcntl(this->dataPtr->handle, F_GETFL, 0) | O_NONBLOCK);
-  #endif
 }
 
 /////////////////////////////////////////////////
@@ -167,10 +131,28 @@ void ArduCopterIRLockPlugin::Load(sensors::SensorPtr _sensor,
         << std::endl;
     return;
   }
+  const std::string transport =
+          _sdf->Get("transport", static_cast<std::string>("udp")).first;
   this->dataPtr->irlock_addr =
           _sdf->Get("irlock_addr", static_cast<std::string>("127.0.0.1")).first;
-  this->dataPtr->irlock_addr =
-          _sdf->Get("irlock_port", 9005).first;
+  this->dataPtr->irlock_port =
+          _sdf->Get("irlock_port", static_cast<uint32_t>(9005)).first;
+
+  this->dataPtr->transport = ArduPilotTransport::Create(transport);
+  if (!this->dataPtr->transport)
+  {
+    gzerr << "transport [" << transport << "] not recognized."
+          << " ArduCopterIRLockPlugin will not be run." << std::endl;
+    return;
+  }
+  if (!this->dataPtr->transport->Connect(this->dataPtr->irlock_addr,
+      this->dataPtr->irlock_port))
+  {
+    gzerr << "failed to connect to " << this->dataPtr->irlock_addr << ":"
+          << this->dataPtr->irlock_port
+          << ". ArduCopterIRLockPlugin will not be run." << std::endl;
+    return;
+  }
 
   this->dataPtr->parentSensor->SetActive(true);
 
@@ -186,6 +168,7 @@ void ArduCopterIRLockPlugin::OnNewFrame(const unsigned char * /*_image*/,
     unsigned int /*_width*/, unsigned int /*_height*/, unsigned int /*_depth*/,
     const std::string &/*_format*/)
 {
+  AP_TRACE_SCOPE("ArduCopterIRLockPlugin::OnNewFrame");
   rendering::CameraPtr camera = this->dataPtr->parentSensor->Camera();
   rendering::ScenePtr scene = camera->GetScene();
 
@@ -270,13 +253,5 @@ void ArduCopterIRLockPlugin::Publish(const std::string &/*_fiducial*/,
   // std::cerr << "fiducial '" << _fiducial << "':" << _x << ", " << _y
   //     << ", pos: " << pkt.pos_x << ", " << pkt.pos_y << std::endl;
 
-  struct sockaddr_in sockaddr;
-  memset(&sockaddr, 0, sizeof(sockaddr));
-  sockaddr.sin_port = htons(this->dataPtr->irlock_port);
-  sockaddr.sin_family = AF_INET;
-  sockaddr.sin_addr.s_addr = inet_addr(this->dataPtr->irlock_addr.c_str());
-  ::sendto(this->dataPtr->handle,
-           reinterpret_cast<raw_type *>(&pkt),
-           sizeof(pkt), 0,
-           (struct sockaddr *)&sockaddr, sizeof(sockaddr));
+  this->dataPtr->transport->Send(&pkt, sizeof(pkt));
 }
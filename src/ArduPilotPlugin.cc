@@ -16,36 +16,42 @@
 */
 #include <functional>
 #include <fcntl.h>
-#ifdef _WIN32
-  #include <Winsock2.h>
-  #include <Ws2def.h>
-  #include <Ws2ipdef.h>
-  #include <Ws2tcpip.h>
-  using raw_type = char;
-#else
-  #include <sys/socket.h>
-  #include <netinet/in.h>
-  #include <netinet/tcp.h>
-  #include <arpa/inet.h>
-  using raw_type = void;
+#ifdef __linux__
+  #include <pthread.h>
+  #include <sched.h>
 #endif
-
-#if defined(_MSC_VER)
-  #include <BaseTsd.h>
-  typedef SSIZE_T ssize_t;
+#ifndef _WIN32
+  #include <poll.h>
+  #include <unistd.h>
 #endif
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
 #include <mutex>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 #include <sdf/sdf.hh>
-#include <ignition/math/Filter.hh>
+#include <ignition/math/Rand.hh>
 #include <gazebo/common/Assert.hh>
 #include <gazebo/common/Plugin.hh>
 #include <gazebo/msgs/msgs.hh>
 #include <gazebo/sensors/sensors.hh>
 #include <gazebo/transport/transport.hh>
+#include "include/ArduPilotHistogram.hh"
+#include "include/ArduPilotMailbox.hh"
+#include "include/ArduPilotTransport.hh"
 #include "include/ArduPilotPlugin.hh"
+#include "include/ArduPilotTrace.hh"
+#include "include/WindFieldPlugin.hh"
 
 #define MAX_MOTORS 255
 
@@ -53,6 +59,25 @@ using namespace gazebo;
 
 GZ_REGISTER_MODEL_PLUGIN(ArduPilotPlugin)
 
+/// \brief "APFN", marks a frame numbered packet
+static const uint32_t kFrameMagic = 0x4e465041;
+
+/// \brief Prefix of servo and state packets when <frameNumbers> is on.
+/// ArduPilot numbers its servo packets, the state packet answering one
+/// carries the same number.
+struct FrameHeader
+{
+  /// \brief kFrameMagic
+  uint32_t magic = kFrameMagic;
+
+  /// \brief Frame number, incremented by ArduPilot for each servo packet
+  uint32_t frameNumber = 0;
+};
+
+/// \brief Frames further back than this are taken as an ArduPilot restart
+/// rather than a reordered packet.
+static const int32_t kReorderWindow = 64;
+
 /// \brief A servo packet.
 struct ServoPacket
 {
@@ -61,7 +86,30 @@ struct ServoPacket
   float motorSpeed[MAX_MOTORS] = {0.0f};
 };
 
-/// \brief Flight Dynamics Model packet that is sent back to the ArduPilot
+/// \brief A servo packet together with its received size, as handed from
+/// the network I/O thread to the physics thread. header and pkt are
+/// contiguous so a numbered packet is received in one go.
+struct ServoFrame
+{
+  /// \brief Frame header, valid if numbered
+  FrameHeader header;
+
+  /// \brief Received packet
+  ServoPacket pkt;
+
+  /// \brief Number of servo packet bytes received
+  ssize_t size = 0;
+
+  /// \brief true if the packet carried a frame header
+  bool numbered = false;
+
+  /// \brief Older packets drained by the receive that got this one
+  uint32_t dropped = 0;
+};
+
+/// \brief Flight Dynamics Model packet that is sent back to the ArduPilot.
+/// This is the legacy wire layout, the optional sensors of StateFrame are
+/// only sent with the v2 protocol.
 struct fdmPacket
 {
   /// \brief packet timestamp
@@ -81,28 +129,510 @@ struct fdmPacket
 
   /// \brief Model position in NED frame
   double positionXYZ[3];
-/*  NOT MERGED IN MASTER YET
-  /// \brief Model latitude in WGS84 system
-  double latitude = 0.0;
+};
+
+/// \brief Largest number of proximity beams a vehicle can have
+static const size_t kMaxProximityBeams = 72;
 
-  /// \brief Model longitude in WGS84 system
-  double longitude = 0.0;
+/// \brief A state packet with its frame header, header and fdm are
+/// contiguous so a numbered packet is sent in one go. The sensors after
+/// fdm are only sent with the v2 protocol.
+struct StateFrame
+{
+  /// \brief Frame header, only sent if <frameNumbers> is on
+  FrameHeader header;
 
-  /// \brief Model altitude from GPS
-  double altitude = 0.0;
+  /// \brief State packet
+  fdmPacket fdm;
 
-  /// \brief Model estimated from airspeed sensor (e.g. Pitot) in m/s
-  double airspeed = 0.0;
+  /// \brief Model latitude, longitude in degrees and altitude in WGS84
+  double gps[3] = {0.0, 0.0, 0.0};
 
-  /// \brief Battery voltage. Default to -1 to use sitl estimator.
-  double battery_voltage = -1.0;
+  /// \brief Model airspeed in m/s
+  double airspeed = 0.0;
 
-  /// \brief Battery Current.
-  double battery_current = 0.0;
+  /// \brief Battery voltage and current, -1 voltage to use sitl estimator
+  double battery[2] = {-1.0, 0.0};
 
-  /// \brief Model rangefinder value. Default to -1 to use sitl rangefinder.
+  /// \brief Rangefinder distance in m
   double rangefinder = -1.0;
-*/
+
+  /// \brief Barometric altitude in m
+  double baro = 0.0;
+
+  /// \brief Number of proximity beams
+  uint32_t proximityCount = 0;
+
+  /// \brief Proximity beam distances in m, -1 for no obstacle in range
+  double proximity[kMaxProximityBeams] = {};
+};
+
+/// \brief "APS2", v2 state packet
+static const uint32_t kStateV2Magic = 0x32535041;
+
+/// \brief "APC2", v2 servo packet, laid out as a FrameHeader followed by
+/// one float per channel
+static const uint32_t kServoV2Magic = 0x32435041;
+
+/////////////////////////////////////////////////
+/// \brief Servo packet order of a reordering link, the highest frame
+/// number wins. Packets without a frame header keep arrival order.
+/// \param[in] _candidate Packet received later.
+/// \param[in] _candidateSize Size of _candidate.
+/// \param[in] _current Packet kept so far.
+/// \param[in] _currentSize Size of _current.
+/// \return True if _candidate replaces _current.
+static bool NewerServoFrame(const void *_candidate,
+    const size_t _candidateSize, const void *_current,
+    const size_t _currentSize)
+{
+  if (_candidateSize < sizeof(FrameHeader) ||
+      _currentSize < sizeof(FrameHeader))
+  {
+    return true;
+  }
+  FrameHeader candidate;
+  FrameHeader current;
+  memcpy(&candidate, _candidate, sizeof(candidate));
+  memcpy(&current, _current, sizeof(current));
+  const auto numbered = [](const FrameHeader &_header)
+  {
+    return _header.magic == kFrameMagic || _header.magic == kServoV2Magic;
+  };
+  if (!numbered(candidate) || !numbered(current))
+  {
+    return true;
+  }
+  const int32_t delta =
+    static_cast<int32_t>(candidate.frameNumber - current.frameNumber);
+  return delta > 0 || delta < -kReorderWindow;
+}
+
+/// \brief Fields of a v2 state packet, serialized in bit order after
+/// the timestamp
+enum StateField : uint32_t
+{
+  /// \brief Angular velocity and linear acceleration, 6 values
+  STATE_IMU = 1u << 0,
+
+  /// \brief Orientation quaternion w, x, y, z, 4 values
+  STATE_ATTITUDE = 1u << 1,
+
+  /// \brief NED velocity, 3 values
+  STATE_VELOCITY = 1u << 2,
+
+  /// \brief NED position, 3 values
+  STATE_POSITION = 1u << 3,
+
+  /// \brief Latitude, longitude, altitude, 3 values, always double
+  STATE_GPS = 1u << 4,
+
+  /// \brief Airspeed, 1 value
+  STATE_AIRSPEED = 1u << 5,
+
+  /// \brief Battery voltage and current, 2 values
+  STATE_BATTERY = 1u << 6,
+
+  /// \brief Rangefinder distance, 1 value
+  STATE_RANGEFINDER = 1u << 7,
+
+  /// \brief Barometric altitude, 1 value
+  STATE_BARO = 1u << 8,
+
+  /// \brief Proximity beam count N followed by N distances
+  STATE_PROXIMITY = 1u << 9
+};
+
+/// \brief Header of a v2 state packet. It is followed by the timestamp as
+/// a double and the fields of fieldMask, as float if STATE_FLAG_FLOAT32
+/// is set and as double otherwise.
+struct StateHeaderV2
+{
+  /// \brief kStateV2Magic
+  uint32_t magic = kStateV2Magic;
+
+  /// \brief Protocol version
+  uint16_t version = 2;
+
+  /// \brief STATE_FLAG_* bits
+  uint16_t flags = 0;
+
+  /// \brief Number of the servo frame this packet answers
+  uint32_t frameNumber = 0;
+
+  /// \brief StateField bits present in the packet
+  uint32_t fieldMask = 0;
+
+  /// \brief Servo channels the plugin expects in each servo packet
+  uint16_t channelCount = 0;
+
+  /// \brief Payload bytes following the header
+  uint16_t payloadSize = 0;
+};
+
+/// \brief Fields other than timestamp and GPS are float32
+static const uint16_t STATE_FLAG_FLOAT32 = 1u << 0;
+
+/// \brief Largest v2 state packet: header, then as doubles the timestamp,
+/// 24 fixed field values, the proximity count and kMaxProximityBeams
+/// distances
+static const size_t kStateV2Capacity = sizeof(StateHeaderV2) +
+  (26 + kMaxProximityBeams) * 8;
+
+/// \brief Lockstep receive timeout derived from ArduPilot's observed
+/// reply interval, in the manner of TCP's retransmission timer: a smoothed
+/// mean and mean deviation of the interval, a timeout a few deviations
+/// past the mean, and exponential back-off on consecutive misses.
+class ReplyTimeoutEstimator
+{
+  /// \brief Set the estimator limits.
+  /// \param[in] _sigma Deviations to wait past the mean interval.
+  /// \param[in] _minMs Smallest timeout.
+  /// \param[in] _maxMs Largest timeout, used until the first sample.
+  public: void Configure(const double _sigma, const uint32_t _minMs,
+      const uint32_t _maxMs)
+  {
+    this->sigma = _sigma;
+    this->minMs = std::max(_minMs, 1u);
+    this->maxMs = std::max(_maxMs, this->minMs);
+  }
+
+  /// \brief Record a reply interval and clear the miss count.
+  /// \param[in] _seconds Time from state packet sent to reply received.
+  public: void AddSample(const double _seconds)
+  {
+    if (!this->hasSample)
+    {
+      this->mean = _seconds;
+      this->deviation = _seconds / 2;
+      this->hasSample = true;
+    }
+    else
+    {
+      const double error = _seconds - this->mean;
+      this->mean += error / 8;
+      this->deviation += (std::abs(error) - this->deviation) / 4;
+    }
+    this->misses = 0;
+  }
+
+  /// \brief Record a receive that timed out, doubling the next timeout.
+  public: void AddMiss()
+  {
+    if (this->misses < 31)
+    {
+      ++this->misses;
+    }
+  }
+
+  /// \brief Forget all samples, e.g. after the controller went offline.
+  public: void Reset()
+  {
+    this->hasSample = false;
+    this->misses = 0;
+  }
+
+  /// \brief Timeout for the next receive.
+  /// \return Milliseconds, within [minMs, maxMs].
+  public: uint32_t TimeoutMs() const
+  {
+    if (!this->hasSample)
+    {
+      return this->maxMs;
+    }
+    const double base =
+      std::ceil((this->mean + this->sigma * this->deviation) * 1000.0);
+    const double timeout = std::ldexp(base, static_cast<int>(this->misses));
+    return static_cast<uint32_t>(std::min(std::max(timeout,
+            static_cast<double>(this->minMs)),
+          static_cast<double>(this->maxMs)));
+  }
+
+  /// \brief Largest timeout.
+  /// \return Milliseconds.
+  public: uint32_t MaxMs() const
+  {
+    return this->maxMs;
+  }
+
+  /// \brief True if the next timeout has backed off to the maximum.
+  public: bool AtMax() const
+  {
+    return this->TimeoutMs() >= this->maxMs;
+  }
+
+  /// \brief Deviations to wait past the mean
+  private: double sigma = 4.0;
+
+  /// \brief Smallest timeout in milliseconds
+  private: uint32_t minMs = 1;
+
+  /// \brief Largest timeout in milliseconds
+  private: uint32_t maxMs = 1000;
+
+  /// \brief Smoothed reply interval in seconds
+  private: double mean = 0;
+
+  /// \brief Smoothed mean deviation of the reply interval in seconds
+  private: double deviation = 0;
+
+  /// \brief true once a reply interval was recorded
+  private: bool hasSample = false;
+
+  /// \brief Consecutive timeouts since the last reply
+  private: uint32_t misses = 0;
+};
+
+/// \brief What the plugin does before ArduPilot first connects
+enum class StartupMode
+{
+  /// \brief Wait 1 ms for a servo packet on every physics step
+  POLL,
+
+  /// \brief Never wait, physics runs at full speed
+  FREE_RUN,
+
+  /// \brief Wait up to maxTimeoutMs on every physics step
+  BLOCK,
+
+  /// \brief Pause the world and resume it when the first servo packet
+  /// arrives, the receive runs off the physics thread
+  PAUSE
+};
+
+/// \brief How physics waits for ArduPilot once it is online
+enum class SyncMode
+{
+  /// \brief Wait for a servo packet on every physics step
+  LOCKSTEP,
+
+  /// \brief Keep stepping with the last command, only wait once the
+  /// command is older than maxStaleness
+  ASYNC
+};
+
+/// \brief World level lockstep coordinator shared by every
+/// ArduPilotPlugin of a world that enables <lockstepBarrier>.
+///
+/// On each world update it first asks every vehicle how long it may wait
+/// for its servo packet, then waits for all of them at once with a single
+/// poll() until each vehicle has a packet or hit its own timeout, and
+/// only then steps the vehicles, which find their packets ready. A world
+/// of N vehicles therefore waits for the slowest ArduPilot instead of for
+/// each one in turn. Vehicles whose transport has no pollable descriptor
+/// (shm, mux, inprocess) wait in their own step as before.
+class LockstepBarrier
+{
+  /// \brief Callbacks of one vehicle
+  public: struct Member
+  {
+    /// \brief Plan the receive of this step.
+    /// Sets the descriptor to wait on, -1 for none, and the wait in ms.
+    std::function<void(int &, uint32_t &)> prepare;
+
+    /// \brief Run the step. The argument is true if the barrier already
+    /// waited on the vehicle's descriptor.
+    std::function<void(bool)> step;
+  };
+
+  /// \brief Get the barrier of a world, creating it on first use.
+  /// \param[in] _worldName World name.
+  /// \return Shared barrier.
+  public: static std::shared_ptr<LockstepBarrier> Get(
+      const std::string &_worldName)
+  {
+    static std::mutex registryMutex;
+    static std::map<std::string, std::weak_ptr<LockstepBarrier>> registry;
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::shared_ptr<LockstepBarrier> barrier = registry[_worldName].lock();
+    if (!barrier)
+    {
+      barrier.reset(new LockstepBarrier);
+      barrier->updateConnection = event::Events::ConnectWorldUpdateBegin(
+          std::bind(&LockstepBarrier::OnUpdate, barrier.get()));
+      registry[_worldName] = barrier;
+    }
+    return barrier;
+  }
+
+  /// \brief Add a vehicle.
+  /// \param[in] _key Unique key, used to unregister.
+  /// \param[in] _member Vehicle callbacks.
+  public: void Register(const void *_key, const Member &_member)
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->members[_key] = _member;
+  }
+
+  /// \brief Remove a vehicle.
+  /// \param[in] _key Key given to Register().
+  public: void Unregister(const void *_key)
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->members.erase(_key);
+  }
+
+  /// \brief World update callback.
+  private: void OnUpdate()
+  {
+    using clock = std::chrono::steady_clock;
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    const size_t count = this->members.size();
+    this->fds.resize(count);
+    this->deadlines.resize(count);
+    this->waited.assign(count, false);
+
+    // Plan every receive before waiting on any of them.
+    const clock::time_point start = clock::now();
+    size_t i = 0;
+    for (auto &member : this->members)
+    {
+      int fd = -1;
+      uint32_t waitMs = 0;
+      member.second.prepare(fd, waitMs);
+      this->fds[i] = fd;
+      this->deadlines[i] = start + std::chrono::milliseconds(waitMs);
+      this->waited[i] = fd >= 0;
+      ++i;
+    }
+
+#ifndef _WIN32
+    // Wait until every vehicle has data or timed out.
+    std::vector<struct pollfd> pfds;
+    std::vector<size_t> index;
+    while (true)
+    {
+      const clock::time_point now = clock::now();
+      clock::time_point next = clock::time_point::max();
+      pfds.clear();
+      index.clear();
+      for (size_t k = 0; k < count; ++k)
+      {
+        if (this->fds[k] >= 0 && this->deadlines[k] > now)
+        {
+          struct pollfd pfd;
+          pfd.fd = this->fds[k];
+          pfd.events = POLLIN;
+          pfd.revents = 0;
+          pfds.push_back(pfd);
+          index.push_back(k);
+          next = std::min(next, this->deadlines[k]);
+        }
+      }
+      if (pfds.empty())
+      {
+        break;
+      }
+      const int timeoutMs = static_cast<int>(
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+            next - now).count()) + 1;
+      if (poll(pfds.data(), pfds.size(), timeoutMs) < 0 && errno != EINTR)
+      {
+        break;
+      }
+      for (size_t k = 0; k < pfds.size(); ++k)
+      {
+        if (pfds[k].revents)
+        {
+          // ready, stop waiting on it
+          this->fds[index[k]] = -1;
+        }
+      }
+    }
+#endif
+
+    i = 0;
+    for (auto &member : this->members)
+    {
+      member.second.step(this->waited[i]);
+      ++i;
+    }
+  }
+
+  /// \brief Protects members
+  private: std::mutex mutex;
+
+  /// \brief Registered vehicles
+  private: std::map<const void *, Member> members;
+
+  /// \brief Per step descriptor of each member, -1 once ready
+  private: std::vector<int> fds;
+
+  /// \brief Per step receive deadline of each member
+  private: std::vector<std::chrono::steady_clock::time_point> deadlines;
+
+  /// \brief Per step, true if the barrier waited for the member
+  private: std::vector<bool> waited;
+
+  /// \brief World update connection
+  private: event::ConnectionPtr updateConnection;
+};
+
+/// \brief Pause of a world shared by the ArduPilotPlugins in startupMode
+/// pause. The world resumes once every holder released it, so a vehicle
+/// whose ArduPilot connects first does not start physics while the
+/// others are still booting.
+class WorldHold
+{
+  /// \brief Get the hold of a world, creating it on first use.
+  /// \param[in] _worldName World name.
+  /// \return Shared hold.
+  public: static std::shared_ptr<WorldHold> Get(
+      const std::string &_worldName)
+  {
+    static std::mutex registryMutex;
+    static std::map<std::string, std::weak_ptr<WorldHold>> registry;
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::shared_ptr<WorldHold> hold = registry[_worldName].lock();
+    if (!hold)
+    {
+      hold.reset(new WorldHold);
+      registry[_worldName] = hold;
+    }
+    return hold;
+  }
+
+  /// \brief Join the hold, pausing the world for the first holder.
+  /// \param[in] _world World to pause.
+  /// \return False if the world was already paused by someone else, it
+  /// is then left alone.
+  public: bool Acquire(const physics::WorldPtr &_world)
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->holders == 0)
+    {
+      if (_world->IsPaused())
+      {
+        return false;
+      }
+      _world->SetPaused(true);
+    }
+    ++this->holders;
+    return true;
+  }
+
+  /// \brief Leave the hold, resuming the world for the last holder.
+  /// \param[in] _world World to resume.
+  /// \return True if the world was resumed.
+  public: bool Release(const physics::WorldPtr &_world)
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->holders == 0 || --this->holders > 0)
+    {
+      return false;
+    }
+    _world->SetPaused(false);
+    return true;
+  }
+
+  /// \brief Protects holders
+  private: std::mutex mutex;
+
+  /// \brief Plugins holding the world
+  private: unsigned int holders = 0;
 };
 
 /// \brief Control class
@@ -132,6 +662,8 @@ class Control
   /// VELOCITY control velocity of joint
   /// POSITION control position of joint
   /// EFFORT control effort of joint
+  /// MOTOR first order motor/ESC model setting joint velocity
+  /// WRENCH command scales a force and torque applied to a link
   public: std::string type;
 
   /// \brief use force controler
@@ -153,7 +685,45 @@ class Control
   public: double rotorVelocitySlowdownSim;
   public: double frequencyCutoff;
   public: double samplingRate;
-  public: ignition::math::OnePole<double> filter;
+
+  /// \brief true if frequencyCutoff was set, enables the joint state
+  /// filter
+  public: bool filterJointState = false;
+
+  /// \brief MOTOR time constant while spinning up, in seconds
+  public: double motorTimeConstantUp = 0.02;
+
+  /// \brief MOTOR time constant while spinning down, in seconds
+  public: double motorTimeConstantDown = 0.02;
+
+  /// \brief true if the rotor is rigid for physics, its thrust and drag
+  /// torque are applied to link and it only spins visually
+  public: bool kinematicSpin = false;
+
+  /// \brief Link carrying a kinematic rotor
+  public: physics::LinkPtr link;
+
+  /// \brief Scoped name of the visual spun for a kinematic rotor, empty
+  /// for none
+  public: std::string visualName;
+
+  /// \brief Kinematic rotor pose in the link frame, spinning about z
+  public: ignition::math::Pose3d rotorPose;
+
+  /// \brief Pose of visualName in the link frame
+  public: ignition::math::Pose3d visualPose;
+
+  /// \brief Kinematic rotor thrust per squared rotor speed
+  public: double thrustCoefficient = 0;
+
+  /// \brief Kinematic rotor drag torque per squared rotor speed
+  public: double torqueCoefficient = 0;
+
+  /// \brief WRENCH force per unit command, link frame
+  public: ignition::math::Vector3d wrenchForce;
+
+  /// \brief WRENCH torque per unit command, link frame
+  public: ignition::math::Vector3d wrenchTorque;
 
   public: static double kDefaultRotorVelocitySlowdownSim;
   public: static double kDefaultFrequencyCutoff;
@@ -164,151 +734,779 @@ double Control::kDefaultRotorVelocitySlowdownSim = 10.0;
 double Control::kDefaultFrequencyCutoff = 5.0;
 double Control::kDefaultSamplingRate = 0.2;
 
-// Private data class
-class gazebo::ArduPilotSocketPrivate
+/// \brief How a control drives its joint, resolved once from
+/// Control::type and Control::useForce
+enum class ControlMode : uint8_t
 {
-  /// \brief constructor
-  public: ArduPilotSocketPrivate()
-  {
-    // initialize socket udp socket
-    fd = socket(AF_INET, SOCK_DGRAM, 0);
-    #ifndef _WIN32
-    // Windows does not support FD_CLOEXEC
-    fcntl(fd, F_SETFD, FD_CLOEXEC);
-    #endif
-  }
+  /// \brief PID on joint velocity, output applied as force
+  VELOCITY_PID,
+
+  /// \brief PID on joint position, output applied as force
+  POSITION_PID,
+
+  /// \brief Command applied as force
+  EFFORT,
+
+  /// \brief Command set as joint velocity
+  SET_VELOCITY,
 
-  /// \brief destructor
-  public: ~ArduPilotSocketPrivate()
+  /// \brief Command set as joint position
+  SET_POSITION,
+
+  /// \brief Command is the steady state speed of a first order motor
+  /// model, whose speed is set as joint velocity
+  MOTOR,
+
+  /// \brief Same motor model driving a rigid rotor, thrust and drag
+  /// torque are applied to its link
+  KINEMATIC_MOTOR,
+
+  /// \brief Command scales a mixer column added to the wrench on a link
+  WRENCH
+};
+
+/// \brief The <control> blocks compiled into structure-of-arrays form.
+///
+/// Load() parses each block into a Control, Compile() then copies what
+/// the physics step needs into contiguous per-channel arrays. The step
+/// gathers joint states, runs the input filter and the PID of every
+/// channel in one pass over the arrays, and scatters the outputs back to
+/// the joints, so the inner loops carry no string compare or branch on
+/// control type. Common motor counts get fixed-size instances of the
+/// loops, which the compiler unrolls and vectorizes.
+class ControlBank
+{
+  /// \brief Build the bank.
+  /// \param[in] _controls Parsed control blocks.
+  public: void Compile(const std::vector<Control> &_controls)
   {
-    if (fd != -1)
+    const size_t n = _controls.size();
+    this->count = n;
+    this->mode.resize(n);
+    this->joints.resize(n);
+    this->links.resize(n);
+    this->rotorPos.resize(n);
+    this->rotorAxis.resize(n);
+    this->wrenchForce.resize(n);
+    this->wrenchTorque.resize(n);
+    this->wrenchLink.assign(n, 0);
+    this->wrenchLinks.clear();
+    this->channel.resize(n);
+    for (auto *v : {&this->cmd, &this->multiplier, &this->offset,
+        &this->targetScale, &this->pGain, &this->iGain, &this->dGain,
+        &this->iMax, &this->iMin, &this->cmdMax, &this->cmdMin,
+        &this->iErr, &this->pErrLast, &this->filterRc, &this->filterState,
+        &this->measured, &this->target, &this->output, &this->tauUp,
+        &this->tauDown, &this->decayUp, &this->decayDown,
+        &this->rotorSpeed, &this->kThrust, &this->kTorque, &this->phase})
     {
-      ::close(fd);
-      fd = -1;
+      v->assign(n, 0.0);
     }
-  }
-
-  /// \brief Bind to an adress and port
-  /// \param[in] _address Address to bind to.
-  /// \param[in] _port Port to bind to.
-  /// \return True on success.
-  public: bool Bind(const char *_address, const uint16_t _port)
-  {
-    struct sockaddr_in sockaddr;
-    this->MakeSockAddr(_address, _port, sockaddr);
 
-    if (bind(this->fd, (struct sockaddr *)&sockaddr, sizeof(sockaddr)) != 0)
+    for (size_t i = 0; i < n; ++i)
     {
-      shutdown(this->fd, 0);
-      #ifdef _WIN32
-      closesocket(this->fd);
-      #else
-      close(this->fd);
-      #endif
-      return false;
+      const Control &control = _controls[i];
+      if (control.type == "POSITION")
+      {
+        this->mode[i] = control.useForce ?
+          ControlMode::POSITION_PID : ControlMode::SET_POSITION;
+      }
+      else if (control.type == "EFFORT")
+      {
+        this->mode[i] = ControlMode::EFFORT;
+      }
+      else if (control.type == "MOTOR")
+      {
+        this->mode[i] = control.kinematicSpin ?
+          ControlMode::KINEMATIC_MOTOR : ControlMode::MOTOR;
+      }
+      else if (control.type == "WRENCH")
+      {
+        this->mode[i] = ControlMode::WRENCH;
+      }
+      else
+      {
+        this->mode[i] = control.useForce ?
+          ControlMode::VELOCITY_PID : ControlMode::SET_VELOCITY;
+      }
+      this->joints[i] = control.joint.get();
+      this->links[i] = control.link.get();
+      this->rotorPos[i] = control.rotorPose.Pos();
+      this->rotorAxis[i] = control.rotorPose.Rot().RotateVector(
+          ignition::math::Vector3d::UnitZ);
+      this->kThrust[i] = control.thrustCoefficient;
+      this->kTorque[i] = control.torqueCoefficient;
+      this->wrenchForce[i] = control.wrenchForce;
+      this->wrenchTorque[i] = control.wrenchTorque;
+      if (this->mode[i] == ControlMode::WRENCH)
+      {
+        // one accumulated wrench per link
+        auto it = std::find(this->wrenchLinks.begin(),
+            this->wrenchLinks.end(), this->links[i]);
+        this->wrenchLink[i] = it - this->wrenchLinks.begin();
+        if (it == this->wrenchLinks.end())
+        {
+          this->wrenchLinks.push_back(this->links[i]);
+        }
+      }
+      this->channel[i] = control.channel;
+      this->multiplier[i] = control.multiplier;
+      this->offset[i] = control.offset;
+      this->targetScale[i] =
+        this->mode[i] == ControlMode::VELOCITY_PID ||
+        this->mode[i] == ControlMode::MOTOR ?
+        1.0 / control.rotorVelocitySlowdownSim : 1.0;
+      this->tauUp[i] = control.motorTimeConstantUp;
+      this->tauDown[i] = control.motorTimeConstantDown;
+      if (this->mode[i] == ControlMode::MOTOR)
+      {
+        // start from the joint's current speed
+        this->rotorSpeed[i] = this->joints[i]->GetVelocity(0);
+      }
+      this->pGain[i] = control.pid.GetPGain();
+      this->iGain[i] = control.pid.GetIGain();
+      this->dGain[i] = control.pid.GetDGain();
+      this->iMax[i] = control.pid.GetIMax();
+      this->iMin[i] = control.pid.GetIMin();
+      this->cmdMax[i] = control.pid.GetCmdMax();
+      this->cmdMin[i] = control.pid.GetCmdMin();
+      this->filterRc[i] = control.filterJointState ?
+        1.0 / (2.0 * IGN_PI * control.frequencyCutoff) : 0.0;
     }
-    int one = 1;
-    setsockopt(this->fd, SOL_SOCKET, SO_REUSEADDR,
-        reinterpret_cast<const char *>(&one), sizeof(one));
-
-    #ifdef _WIN32
-    u_long on = 1;
-    ioctlsocket(this->fd, FIONBIO,
-              reinterpret_cast<u_long FAR *>(&on));
-    #else
-    fcntl(this->fd, F_SETFL,
-        fcntl(this->fd, F_GETFL, 0) | O_NONBLOCK);
-    #endif
-    return true;
+    this->linkForce.resize(this->wrenchLinks.size());
+    this->linkTorque.resize(this->wrenchLinks.size());
+    this->decayDt = 0.0;
   }
 
-  /// \brief Connect to an adress and port
-  /// \param[in] _address Address to connect to.
-  /// \param[in] _port Port to connect to.
-  /// \return True on success.
-  public : bool Connect(const char *_address, const uint16_t _port)
+  /// \brief Number of controls.
+  public: size_t Size() const
   {
-    struct sockaddr_in sockaddr;
-    this->MakeSockAddr(_address, _port, sockaddr);
-
-    if (connect(this->fd, (struct sockaddr *)&sockaddr, sizeof(sockaddr)) != 0)
-    {
-      shutdown(this->fd, 0);
-      #ifdef _WIN32
-      closesocket(this->fd);
-      #else
-      close(this->fd);
-      #endif
-      return false;
-    }
-    int one = 1;
-    setsockopt(this->fd, SOL_SOCKET, SO_REUSEADDR,
-        reinterpret_cast<const char *>(&one), sizeof(one));
-
-    #ifdef _WIN32
-    u_long on = 1;
-    ioctlsocket(this->fd, FIONBIO,
-              reinterpret_cast<u_long FAR *>(&on));
-    #else
-    fcntl(this->fd, F_SETFL,
-        fcntl(this->fd, F_GETFL, 0) | O_NONBLOCK);
-    #endif
-    return true;
+    return this->count;
   }
 
-  /// \brief Make a socket
-  /// \param[in] _address Socket address.
-  /// \param[in] _port Socket port
-  /// \param[out] _sockaddr New socket address structure.
-  public: void MakeSockAddr(const char *_address, const uint16_t _port,
-    struct sockaddr_in &_sockaddr)
+  /// \brief Zero every command.
+  public: void ResetCommands()
   {
-    memset(&_sockaddr, 0, sizeof(_sockaddr));
-
-    #ifdef HAVE_SOCK_SIN_LEN
-      _sockaddr.sin_len = sizeof(_sockaddr);
-    #endif
-
-    _sockaddr.sin_port = htons(_port);
-    _sockaddr.sin_family = AF_INET;
-    _sockaddr.sin_addr.s_addr = inet_addr(_address);
+    std::fill(this->cmd.begin(), this->cmd.end(), 0.0);
   }
 
-  public: ssize_t Send(const void *_buf, size_t _size)
+  /// \brief Run the controllers and drive the joints.
+  /// \param[in] _dt Time step in seconds.
+  public: void Update(const double _dt)
   {
-    return send(this->fd, _buf, _size, 0);
+    if (_dt <= 0.0)
+    {
+      return;
+    }
+    switch (this->count)
+    {
+      case 4:
+        this->UpdateN<4>(_dt);
+        break;
+      case 6:
+        this->UpdateN<6>(_dt);
+        break;
+      case 8:
+        this->UpdateN<8>(_dt);
+        break;
+      default:
+        this->UpdateN<0>(_dt);
+        break;
+    }
   }
 
-  /// \brief Receive data
-  /// \param[out] _buf Buffer that receives the data.
-  /// \param[in] _size Size of the buffer.
-  /// \param[in] _timeoutMS Milliseconds to wait for data.
-  public: ssize_t Recv(void *_buf, const size_t _size, uint32_t _timeoutMs)
+  /// \brief Update with a channel count known at compile time.
+  /// \tparam N Number of controls, 0 if only known at run time.
+  /// \param[in] _dt Time step in seconds.
+  private: template <size_t N>
+  void UpdateN(const double _dt)
   {
-    fd_set fds;
-    struct timeval tv;
+    const size_t n = N > 0 ? N : this->count;
 
-    FD_ZERO(&fds);
-    FD_SET(this->fd, &fds);
+    // gather joint states and targets
+    for (size_t i = 0; i < n; ++i)
+    {
+      switch (this->mode[i])
+      {
+        case ControlMode::VELOCITY_PID:
+          this->measured[i] = this->joints[i]->GetVelocity(0);
+          break;
+        case ControlMode::POSITION_PID:
+          this->measured[i] = this->joints[i]->Position();
+          break;
+        default:
+          break;
+      }
+    }
 
-    tv.tv_sec = _timeoutMs / 1000;
-    tv.tv_usec = (_timeoutMs % 1000) * 1000UL;
+    double *const meas = this->measured.data();
+    double *const tgt = this->target.data();
+    double *const out = this->output.data();
+    const double *const c = this->cmd.data();
+    const double *const scale = this->targetScale.data();
+    const double *const rc = this->filterRc.data();
 
-    if (select(this->fd+1, &fds, NULL, NULL, &tv) != 1)
+    for (size_t i = 0; i < n; ++i)
     {
-        return -1;
+      tgt[i] = c[i] * scale[i];
     }
 
-    #ifdef _WIN32
-    return recv(this->fd, reinterpret_cast<char *>(_buf), _size, 0);
-    #else
-    return recv(this->fd, _buf, _size, 0);
-    #endif
-  }
-
-  /// \brief Socket handle
-  private: int fd;
-};
+    // first order low-pass on the joint state, rc 0 passes through
+    double *const state = this->filterState.data();
+    for (size_t i = 0; i < n; ++i)
+    {
+      const double alpha = _dt / (rc[i] + _dt);
+      meas[i] = state[i] + alpha * (meas[i] - state[i]);
+      state[i] = meas[i];
+    }
+
+    // PID, same arithmetic as gazebo::common::PID::Update()
+    const double *const kp = this->pGain.data();
+    const double *const ki = this->iGain.data();
+    const double *const kd = this->dGain.data();
+    const double *const iLo = this->iMin.data();
+    const double *const iHi = this->iMax.data();
+    const double *const outLo = this->cmdMin.data();
+    const double *const outHi = this->cmdMax.data();
+    double *const iE = this->iErr.data();
+    double *const pLast = this->pErrLast.data();
+    for (size_t i = 0; i < n; ++i)
+    {
+      const double error = meas[i] - tgt[i];
+      iE[i] = std::max(std::min(iE[i] + ki[i] * _dt * error, iHi[i]),
+          iLo[i]);
+      const double dErr = (error - pLast[i]) / _dt;
+      pLast[i] = error;
+      double u = -kp[i] * error - iE[i] - kd[i] * dErr;
+      // a zero limit means unlimited
+      u = std::fabs(outHi[i]) > 1e-6 ? std::min(u, outHi[i]) : u;
+      u = std::fabs(outLo[i]) > 1e-6 ? std::max(u, outLo[i]) : u;
+      out[i] = u;
+    }
+
+    // Motor models. The lag w' = (w_ss - w) / tau has the exact solution
+    // w(t + dt) = w_ss + (w(t) - w_ss) exp(-dt / tau) for a command held
+    // over the step, which is stable for any dt, unlike a PID driving
+    // the joint through the physics engine.
+    if (!ignition::math::equal(_dt, this->decayDt))
+    {
+      for (size_t i = 0; i < n; ++i)
+      {
+        this->decayUp[i] = this->tauUp[i] > 0.0 ?
+          std::exp(-_dt / this->tauUp[i]) : 0.0;
+        this->decayDown[i] = this->tauDown[i] > 0.0 ?
+          std::exp(-_dt / this->tauDown[i]) : 0.0;
+      }
+      this->decayDt = _dt;
+    }
+    const double *const kUp = this->decayUp.data();
+    const double *const kDown = this->decayDown.data();
+    double *const w = this->rotorSpeed.data();
+    double *const angle = this->phase.data();
+    for (size_t i = 0; i < n; ++i)
+    {
+      const double k = std::fabs(tgt[i]) > std::fabs(w[i]) ?
+        kUp[i] : kDown[i];
+      w[i] = tgt[i] + (w[i] - tgt[i]) * k;
+      angle[i] = std::fmod(angle[i] + w[i] * _dt, 2.0 * IGN_PI);
+    }
+
+    // mixer, each WRENCH command scales its column of the link wrench
+    for (size_t k = 0; k < this->wrenchLinks.size(); ++k)
+    {
+      this->linkForce[k] = ignition::math::Vector3d::Zero;
+      this->linkTorque[k] = ignition::math::Vector3d::Zero;
+    }
+
+    // scatter to the joints
+    for (size_t i = 0; i < n; ++i)
+    {
+      switch (this->mode[i])
+      {
+        case ControlMode::VELOCITY_PID:
+        case ControlMode::POSITION_PID:
+          this->joints[i]->SetForce(0, out[i]);
+          break;
+        case ControlMode::EFFORT:
+          this->joints[i]->SetForce(0, c[i]);
+          break;
+        case ControlMode::SET_VELOCITY:
+          this->joints[i]->SetVelocity(0, c[i]);
+          break;
+        case ControlMode::SET_POSITION:
+          this->joints[i]->SetPosition(0, c[i]);
+          break;
+        case ControlMode::MOTOR:
+          this->joints[i]->SetVelocity(0, w[i]);
+          break;
+        case ControlMode::KINEMATIC_MOTOR:
+        {
+          // thrust along the rotor axis whichever way it turns, drag
+          // torque against the rotation
+          const double w2 = w[i] * std::fabs(w[i]);
+          this->links[i]->AddLinkForce(
+              this->rotorAxis[i] * (this->kThrust[i] * std::fabs(w2)),
+              this->rotorPos[i]);
+          this->links[i]->AddRelativeTorque(
+              this->rotorAxis[i] * (-this->kTorque[i] * w2));
+          break;
+        }
+        case ControlMode::WRENCH:
+          this->linkForce[this->wrenchLink[i]] += this->wrenchForce[i] * c[i];
+          this->linkTorque[this->wrenchLink[i]] +=
+            this->wrenchTorque[i] * c[i];
+          break;
+        default:
+          break;
+      }
+    }
+    for (size_t k = 0; k < this->wrenchLinks.size(); ++k)
+    {
+      this->wrenchLinks[k]->AddRelativeForce(this->linkForce[k]);
+      this->wrenchLinks[k]->AddRelativeTorque(this->linkTorque[k]);
+    }
+  }
+
+  /// \brief Number of controls
+  public: size_t count = 0;
+
+  /// \brief Control mode
+  public: std::vector<ControlMode> mode;
+
+  /// \brief Driven joint
+  public: std::vector<physics::Joint *> joints;
+
+  /// \brief Servo channel
+  public: std::vector<int> channel;
+
+  /// \brief Current command
+  public: std::vector<double> cmd;
+
+  /// \brief Command multiplier
+  public: std::vector<double> multiplier;
+
+  /// \brief Command offset
+  public: std::vector<double> offset;
+
+  /// \brief Command to PID target factor, 1 / rotorVelocitySlowdownSim
+  /// for velocity control
+  public: std::vector<double> targetScale;
+
+  /// \brief PID proportional gain
+  public: std::vector<double> pGain;
+
+  /// \brief PID integral gain
+  public: std::vector<double> iGain;
+
+  /// \brief PID derivative gain
+  public: std::vector<double> dGain;
+
+  /// \brief PID integral term upper limit
+  public: std::vector<double> iMax;
+
+  /// \brief PID integral term lower limit
+  public: std::vector<double> iMin;
+
+  /// \brief PID output upper limit, 0 for none
+  public: std::vector<double> cmdMax;
+
+  /// \brief PID output lower limit, 0 for none
+  public: std::vector<double> cmdMin;
+
+  /// \brief PID integral term
+  public: std::vector<double> iErr;
+
+  /// \brief PID error of the previous step
+  public: std::vector<double> pErrLast;
+
+  /// \brief Joint state filter time constant, 0 for no filtering
+  public: std::vector<double> filterRc;
+
+  /// \brief Joint state filter output
+  public: std::vector<double> filterState;
+
+  /// \brief Joint state of the step
+  public: std::vector<double> measured;
+
+  /// \brief PID target of the step
+  public: std::vector<double> target;
+
+  /// \brief PID output of the step
+  public: std::vector<double> output;
+
+  /// \brief Motor spin up time constant
+  public: std::vector<double> tauUp;
+
+  /// \brief Motor spin down time constant
+  public: std::vector<double> tauDown;
+
+  /// \brief exp(-dt / tauUp) for decayDt
+  public: std::vector<double> decayUp;
+
+  /// \brief exp(-dt / tauDown) for decayDt
+  public: std::vector<double> decayDown;
+
+  /// \brief Step size decayUp and decayDown were computed for
+  public: double decayDt = 0.0;
+
+  /// \brief Motor model speed
+  public: std::vector<double> rotorSpeed;
+
+  /// \brief Motor model rotor angle, wrapped to one turn
+  public: std::vector<double> phase;
+
+  /// \brief Link carrying a kinematic rotor
+  public: std::vector<physics::Link *> links;
+
+  /// \brief Kinematic rotor position in the link frame
+  public: std::vector<ignition::math::Vector3d> rotorPos;
+
+  /// \brief Kinematic rotor axis in the link frame
+  public: std::vector<ignition::math::Vector3d> rotorAxis;
+
+  /// \brief Kinematic rotor thrust coefficient
+  public: std::vector<double> kThrust;
+
+  /// \brief Kinematic rotor torque coefficient
+  public: std::vector<double> kTorque;
+
+  /// \brief WRENCH force column, link frame
+  public: std::vector<ignition::math::Vector3d> wrenchForce;
+
+  /// \brief WRENCH torque column, link frame
+  public: std::vector<ignition::math::Vector3d> wrenchTorque;
+
+  /// \brief Index of the WRENCH link in wrenchLinks
+  public: std::vector<size_t> wrenchLink;
+
+  /// \brief Links driven by WRENCH controls
+  public: std::vector<physics::Link *> wrenchLinks;
+
+  /// \brief Force accumulated on each of wrenchLinks in the step
+  public: std::vector<ignition::math::Vector3d> linkForce;
+
+  /// \brief Torque accumulated on each of wrenchLinks in the step
+  public: std::vector<ignition::math::Vector3d> linkTorque;
+};
+
+/// \brief Visual of a kinematic rotor, posed from the motor model angle
+struct SpinVisual
+{
+  /// \brief Index in the control bank
+  size_t index;
+
+  /// \brief Visual pose in its link frame at zero angle
+  ignition::math::Pose3d pose;
+
+  /// \brief Pose update message, name and parent set once
+  msgs::Visual msg;
+};
+
+/// \brief Find a sensor of a model, trying scoped names first.
+/// \param[in] _model Model owning the sensor.
+/// \param[in] _name Sensor name.
+/// \return The sensor, or nullptr if not found.
+template <typename SensorT>
+static std::shared_ptr<SensorT> FindModelSensor(
+    const physics::ModelPtr &_model, const std::string &_name)
+{
+  for (const auto &scopedName : _model->SensorScopedName(_name))
+  {
+    auto sensor = std::dynamic_pointer_cast<SensorT>(
+        sensors::SensorManager::Instance()->GetSensor(scopedName));
+    if (sensor)
+    {
+      return sensor;
+    }
+  }
+  return std::dynamic_pointer_cast<SensorT>(
+      sensors::SensorManager::Instance()->GetSensor(_name));
+}
+
+/// \brief IMU reading
+struct ImuSample
+{
+  /// \brief Linear acceleration
+  ignition::math::Vector3d accel;
+
+  /// \brief Angular velocity
+  ignition::math::Vector3d gyro;
+};
+
+/// \brief A model sensor resolved once at load. Value() only reads the
+/// sensor when it has updated since the previous read, and returns the
+/// cached value otherwise.
+template <typename SensorT, typename ValueT>
+class SensorBinding
+{
+  /// \brief Function reading a value from the sensor
+  public: using Sampler = ValueT (*)(SensorT &);
+
+  /// \brief Resolve the sensor.
+  /// \param[in] _model Model owning the sensor.
+  /// \param[in] _name Sensor name, scoped or not.
+  /// \param[in] _sample Function reading the sensor.
+  /// \return True if the sensor was found.
+  public: bool Bind(const physics::ModelPtr &_model,
+      const std::string &_name, Sampler _sample)
+  {
+    this->sensor = FindModelSensor<SensorT>(_model, _name);
+    this->sample = _sample;
+    this->hasValue = false;
+    return this->sensor != nullptr;
+  }
+
+  /// \brief True if bound to a sensor.
+  public: explicit operator bool() const
+  {
+    return this->sensor != nullptr;
+  }
+
+  /// \brief Latest sensor value, must be bound.
+  public: const ValueT &Value()
+  {
+    const common::Time updated = this->sensor->LastUpdateTime();
+    if (!this->hasValue || updated != this->lastUpdate)
+    {
+      this->value = this->sample(*this->sensor);
+      this->lastUpdate = updated;
+      this->hasValue = true;
+      ++this->reads;
+    }
+    else
+    {
+      ++this->reuses;
+    }
+    return this->value;
+  }
+
+  /// \brief Number of Value() calls that read the sensor
+  public: uint64_t reads = 0;
+
+  /// \brief Number of Value() calls that returned the cached value
+  public: uint64_t reuses = 0;
+
+  /// \brief Bound sensor
+  private: std::shared_ptr<SensorT> sensor;
+
+  /// \brief Reads the sensor
+  private: Sampler sample = nullptr;
+
+  /// \brief Cached value
+  private: ValueT value = ValueT();
+
+  /// \brief Sensor update time of the cached value
+  private: common::Time lastUpdate;
+
+  /// \brief True once value was read
+  private: bool hasValue = false;
+};
+
+/// \brief Distance sensors measured with physics ray queries on the
+/// physics thread, with no rendering and no sensor thread.
+///
+/// One ray shape is reused for every beam, all beams are cast in one
+/// pass when the state packet is built. Beams start minRange out from
+/// the sensor origin so they can clear the vehicle's own collisions.
+class RayBatch
+{
+  /// \brief Load <rayRangefinder> and <rayProximity> elements.
+  /// \param[in] _model Vehicle model.
+  /// \param[in] _sdf Plugin element.
+  /// \param[in] _modelName Model name for messages.
+  /// \return False if a sensor is misconfigured.
+  public: bool Load(const physics::ModelPtr &_model, sdf::ElementPtr _sdf,
+      const std::string &_modelName)
+  {
+    if (_sdf->HasElement("rayRangefinder"))
+    {
+      sdf::ElementPtr elem = _sdf->GetElement("rayRangefinder");
+      if (!this->AddBeams(_model, elem, 1, 0.0, 0.0, _modelName))
+      {
+        return false;
+      }
+      this->rangefinderBeam = 0;
+    }
+
+    sdf::ElementPtr elem;
+    if (_sdf->HasElement("rayProximity"))
+    {
+      elem = _sdf->GetElement("rayProximity");
+    }
+    while (elem)
+    {
+      const int count = elem->Get("beams", 8).first;
+      const size_t total = this->ProximityCount() + std::max(count, 0);
+      if (count < 1 || total > kMaxProximityBeams)
+      {
+        gzerr << "[" << _modelName << "] "
+              << "<rayProximity> needs 1 to " << kMaxProximityBeams
+              << " beams in total.\n";
+        return false;
+      }
+      // beams fan out about the sensor z axis, a full turn by default
+      const double minAngle = elem->Get("minAngle", -IGN_PI).first;
+      const double maxAngle = elem->Get("maxAngle", IGN_PI).first;
+      const bool fullTurn = maxAngle - minAngle >= 2.0 * IGN_PI - 1e-6;
+      const double step = count < 2 ? 0.0 :
+        (maxAngle - minAngle) / (fullTurn ? count : count - 1);
+      if (!this->AddBeams(_model, elem, count, minAngle, step, _modelName))
+      {
+        return false;
+      }
+      elem = elem->GetNextElement("rayProximity");
+    }
+
+    if (this->beams.empty())
+    {
+      return true;
+    }
+    physics::PhysicsEnginePtr engine = _model->GetWorld()->Physics();
+    this->shape = engine->CreateShape("ray", physics::CollisionPtr());
+    this->ray = dynamic_cast<physics::RayShape *>(this->shape.get());
+    if (!this->ray)
+    {
+      gzerr << "[" << _modelName << "] "
+            << "physics engine has no ray shape, ray sensors disabled.\n";
+      this->beams.clear();
+      this->rangefinderBeam = -1;
+      return false;
+    }
+    this->distance.assign(this->beams.size(), -1.0);
+    return true;
+  }
+
+  /// \brief True if a <rayRangefinder> is loaded.
+  public: bool HasRangefinder() const
+  {
+    return this->rangefinderBeam >= 0;
+  }
+
+  /// \brief Number of proximity beams.
+  public: size_t ProximityCount() const
+  {
+    return this->beams.size() - (this->HasRangefinder() ? 1 : 0);
+  }
+
+  /// \brief Cast every beam.
+  public: void Cast()
+  {
+    std::string entity;
+    double dist;
+    physics::Link *link = nullptr;
+    ignition::math::Pose3d pose;
+    for (size_t i = 0; i < this->beams.size(); ++i)
+    {
+      const Beam &beam = this->beams[i];
+      if (beam.link != link)
+      {
+        // beams of one link share its pose lookup
+        link = beam.link;
+        pose = link->WorldPose();
+      }
+      const ignition::math::Vector3d start =
+        pose.CoordPositionAdd(beam.start);
+      const ignition::math::Vector3d end =
+        pose.CoordPositionAdd(beam.end);
+      this->ray->SetPoints(start, end);
+      this->ray->GetIntersection(dist, entity);
+      this->distance[i] = entity.empty() ? -1.0 : beam.minRange + dist;
+    }
+  }
+
+  /// \brief Rangefinder distance of the last Cast(), -1 for none.
+  public: double Rangefinder() const
+  {
+    return this->distance[this->rangefinderBeam];
+  }
+
+  /// \brief Copy the proximity distances of the last Cast().
+  /// \param[out] _out At least ProximityCount() values.
+  public: void Proximity(double *_out) const
+  {
+    const size_t first = this->HasRangefinder() ? 1 : 0;
+    std::copy(this->distance.begin() + first, this->distance.end(), _out);
+  }
+
+  /// \brief Add the beams of one sensor element.
+  /// \param[in] _model Vehicle model.
+  /// \param[in] _elem Sensor element.
+  /// \param[in] _count Number of beams.
+  /// \param[in] _angle Angle of the first beam about the sensor z axis.
+  /// \param[in] _step Angle between beams.
+  /// \param[in] _modelName Model name for messages.
+  /// \return False if the link is not found.
+  private: bool AddBeams(const physics::ModelPtr &_model,
+      sdf::ElementPtr _elem, const int _count, const double _angle,
+      const double _step, const std::string &_modelName)
+  {
+    const std::string linkName =
+      _elem->Get("link", std::string()).first;
+    physics::LinkPtr link = linkName.empty() ?
+      _model->GetLink() : _model->GetLink(linkName);
+    if (!link)
+    {
+      gzerr << "[" << _modelName << "] "
+            << "ray sensor link [" << linkName << "] not found.\n";
+      return false;
+    }
+    this->links.push_back(link);
+
+    // sensor pose in the link frame, beams along its x axis
+    const ignition::math::Pose3d pose =
+      _elem->Get("pose", ignition::math::Pose3d()).first;
+    const double minRange = _elem->Get("minRange", 0.1).first;
+    const double maxRange = _elem->Get("maxRange", 10.0).first;
+    for (int k = 0; k < _count; ++k)
+    {
+      const ignition::math::Quaterniond yaw(0.0, 0.0, _angle + k * _step);
+      const ignition::math::Vector3d dir =
+        pose.Rot().RotateVector(yaw.RotateVector(
+              ignition::math::Vector3d::UnitX));
+      Beam beam;
+      beam.link = link.get();
+      beam.start = pose.Pos() + dir * minRange;
+      beam.end = pose.Pos() + dir * maxRange;
+      beam.minRange = minRange;
+      this->beams.push_back(beam);
+    }
+    return true;
+  }
+
+  /// \brief One ray
+  private: struct Beam
+  {
+    /// \brief Link the ray is fixed to
+    physics::Link *link;
+
+    /// \brief Ray start in the link frame
+    ignition::math::Vector3d start;
+
+    /// \brief Ray end in the link frame
+    ignition::math::Vector3d end;
+
+    /// \brief Distance from the sensor origin to start
+    double minRange;
+  };
+
+  /// \brief Beams, the rangefinder first if any
+  private: std::vector<Beam> beams;
+
+  /// \brief Links the beams are fixed to, kept alive
+  private: std::vector<physics::LinkPtr> links;
+
+  /// \brief Distance of each beam from its last cast
+  private: std::vector<double> distance;
+
+  /// \brief Index of the rangefinder beam, -1 for none
+  private: int rangefinderBeam = -1;
+
+  /// \brief Ray shape shared by all beams
+  private: physics::ShapePtr shape;
+
+  /// \brief shape as a ray
+  private: physics::RayShape *ray = nullptr;
+};
 
 // Private data class
 class gazebo::ArduPilotPluginPrivate
@@ -322,20 +1520,89 @@ class gazebo::ArduPilotPluginPrivate
   /// \brief String of the model name;
   public: std::string modelName;
 
-  /// \brief array of propellers
+  /// \brief array of propellers, as parsed from the <control> blocks
   public: std::vector<Control> controls;
 
+  /// \brief controls compiled for the physics step
+  public: ControlBank bank;
+
+  /// \brief Visuals of the kinematic rotors
+  public: std::vector<SpinVisual> spinVisuals;
+
+  /// \brief Seconds between kinematic rotor visual updates
+  public: double spinVisualPeriod = 1.0 / 30.0;
+
+  /// \brief Sim time of the last kinematic rotor visual update
+  public: gazebo::common::Time lastSpinVisualTime;
+
+  /// \brief Transport node for the kinematic rotor visuals
+  public: transport::NodePtr node;
+
+  /// \brief Publisher of the kinematic rotor visual poses
+  public: transport::PublisherPtr visualPub;
+
+  /// \brief Look up the link, pose and visual of a kinematic rotor.
+  /// \param[in] _sdf <control> element.
+  /// \param[in,out] _control Control being loaded.
+  /// \return False if the link or visual cannot be found.
+  public: bool LoadKinematicRotor(sdf::ElementPtr _sdf, Control &_control);
+
+  /// \brief Look up the link and mixer column of a WRENCH control.
+  /// \param[in] _sdf <control> element.
+  /// \param[in,out] _control Control being loaded.
+  /// \return False if the link cannot be found.
+  public: bool LoadWrench(sdf::ElementPtr _sdf, Control &_control);
+
+  /// \brief Publish the kinematic rotor visual poses, at most once per
+  /// spinVisualPeriod.
+  /// \param[in] _now Current sim time.
+  public: void PublishSpinVisuals(const common::Time &_now);
+
+  /// \brief Wall time spent waiting for servo packets on the physics
+  /// thread, ns
+  public: LogHistogram recvWaitNs;
+
+  /// \brief Wall time of ApplyMotorForces(), ns
+  public: LogHistogram motorForcesNs;
+
+  /// \brief Wall time of SendState(), ns
+  public: LogHistogram sendStateNs;
+
+  /// \brief Older packets drained per applied servo packet
+  public: LogHistogram drainedPackets;
+
+  /// \brief Waits of the physics thread for an online ArduPilot that
+  /// expired without a packet
+  public: uint64_t recvTimeouts = 0;
+
+  /// \brief Publisher of the timing statistics
+  public: transport::PublisherPtr statsPub;
+
+  /// \brief Seconds between timing statistics messages
+  public: double statsPeriod = 1.0;
+
+  /// \brief Sim time of the last timing statistics message
+  public: gazebo::common::Time lastStatsTime;
+
+  /// \brief Summarize the timing statistics.
+  /// \return One line per histogram.
+  public: std::string StatsReport() const;
+
+  /// \brief Publish the timing statistics, at most once per statsPeriod.
+  /// \param[in] _now Current sim time.
+  public: void PublishStats(const common::Time &_now);
+
   /// \brief keep track of controller update sim-time.
   public: gazebo::common::Time lastControllerUpdateTime;
 
   /// \brief Controller update mutex.
   public: std::mutex mutex;
 
-  /// \brief Ardupilot Socket for receive motor command on gazebo
-  public: ArduPilotSocketPrivate socket_in;
+  /// \brief Link to Ardupilot, receives motor commands and sends state
+  public: std::unique_ptr<ArduPilotTransport> transport;
 
-  /// \brief Ardupilot Socket to send state to Ardupilot
-  public: ArduPilotSocketPrivate socket_out;
+  /// \brief Transport type, see ArduPilotTransport::Create
+  public: std::string transport_type;
 
   /// \brief Ardupilot address
   public: std::string fdm_addr;
@@ -349,14 +1616,70 @@ class gazebo::ArduPilotPluginPrivate
   /// \brief Ardupilot port for sender socket
   public: uint16_t fdm_port_out;
 
-  /// \brief Pointer to an IMU sensor
-  public: sensors::ImuSensorPtr imuSensor;
+  /// \brief IMU sensor, unbound if computed from imuLink
+  public: SensorBinding<sensors::ImuSensor, ImuSample> imu;
+
+  /// \brief Link the IMU is computed from, null to read imu
+  public: physics::LinkPtr imuLink;
+
+  /// \brief imuLink world velocity at imuLastTime
+  public: ignition::math::Vector3d imuLastVel;
+
+  /// \brief Sim time of the last imuLink sample
+  public: gazebo::common::Time imuLastTime;
+
+  /// \brief False until imuLink has been sampled once
+  public: bool imuHasLast = false;
+
+  /// \brief imuLink world acceleration over the last step
+  public: ignition::math::Vector3d imuWorldAccel;
+
+  /// \brief Gyro white noise standard deviation, rad/s
+  public: double gyroNoise = 0.0;
+
+  /// \brief Accelerometer white noise standard deviation, m/s^2
+  public: double accelNoise = 0.0;
+
+  /// \brief Gyro bias random walk, rad/s/sqrt(s)
+  public: double gyroBiasWalk = 0.0;
+
+  /// \brief Accelerometer bias random walk, m/s^2/sqrt(s)
+  public: double accelBiasWalk = 0.0;
+
+  /// \brief Current gyro bias
+  public: ignition::math::Vector3d gyroBias;
+
+  /// \brief Current accelerometer bias
+  public: ignition::math::Vector3d accelBias;
 
-  /// \brief Pointer to an GPS sensor
-  public: sensors::GpsSensorPtr gpsSensor;
+  /// \brief Read the IMU, from imuLink if set, else from imu.
+  /// \param[out] _accel Specific force in the IMU frame.
+  /// \param[out] _gyro Angular velocity in the IMU frame.
+  public: void ReadImu(ignition::math::Vector3d &_accel,
+      ignition::math::Vector3d &_gyro);
 
-  /// \brief Pointer to an Rangefinder sensor
-  public: sensors::RaySensorPtr rangefinderSensor;
+  /// \brief GPS sensor, latitude and longitude in degrees and altitude
+  public: SensorBinding<sensors::GpsSensor, ignition::math::Vector3d> gps;
+
+  /// \brief Rangefinder sensor, distance of the first ray
+  public: SensorBinding<sensors::RaySensor, double> rangefinder;
+
+  /// \brief Barometer, altimeter sensor altitude
+  public: SensorBinding<sensors::AltimeterSensor, double> baro;
+
+  /// \brief Physics ray rangefinder and proximity beams
+  public: RayBatch rays;
+
+  /// \brief Wind at the model.
+  /// \return Wind velocity in the world frame, zero without a
+  /// WindFieldPlugin in the world.
+  public: ignition::math::Vector3d Wind();
+
+  /// \brief Wind field of the world, looked up on first use
+  public: std::shared_ptr<const WindField> wind;
+
+  /// \brief True once the wind field was looked up
+  public: bool windLookedUp = false;
 
   /// \brief false before ardupilot controller is online
   /// to allow gazebo to continue without waiting
@@ -368,8 +1691,243 @@ class gazebo::ArduPilotPluginPrivate
   /// \brief number of times ArduCotper skips update
   /// before marking ArduPilot offline
   public: int connectionTimeoutMaxCount;
+
+  /// \brief number of stale servo packets discarded while draining
+  public: uint64_t droppedPacketCount = 0;
+
+  /// \brief true if servo and state packets carry a FrameHeader
+  public: bool frameNumbers = false;
+
+  /// \brief true to use the v2 state and servo packets
+  public: bool protocolV2 = false;
+
+  /// \brief StateField bits sent with the v2 protocol
+  public: uint32_t stateFieldMask = 0;
+
+  /// \brief true to send v2 fields as float32
+  public: bool stateFloat32 = false;
+
+  /// \brief Servo channels the model uses, advertised to ArduPilot
+  public: uint16_t servoChannelCount = 0;
+
+  /// \brief Reusable v2 state packet buffer, only touched by the thread
+  /// that sends
+  public: uint8_t stateBuffer[kStateV2Capacity];
+
+  /// \brief Number of the newest servo frame received
+  public: uint32_t lastFrameNumber = 0;
+
+  /// \brief true once a numbered servo frame was received
+  public: bool hasFrameNumber = false;
+
+  /// \brief Number of the servo frame the next state packet answers
+  public: uint32_t answerFrameNumber = 0;
+
+  /// \brief Numbered servo frames received
+  public: uint64_t framesReceived = 0;
+
+  /// \brief Numbered servo frames never received
+  public: uint64_t framesLost = 0;
+
+  /// \brief Numbered servo frames received twice
+  public: uint64_t framesDuplicated = 0;
+
+  /// \brief Numbered servo frames received after a newer one
+  public: uint64_t framesReordered = 0;
+
+  /// \brief Times the frame numbers restarted, i.e. ArduPilot restarted
+  public: uint64_t frameRestarts = 0;
+
+  /// \brief Receive timeout while ArduPilot is online
+  public: ReplyTimeoutEstimator replyTimeout;
+
+  /// \brief Time the last state packet was sent
+  public: std::chrono::steady_clock::time_point lastSendTime;
+
+  /// \brief true if a state packet was sent since the last reply
+  public: bool awaitingReply = false;
+
+  /// \brief Behaviour before ArduPilot first connects
+  public: StartupMode startupMode = StartupMode::POLL;
+
+  /// \brief How physics waits for ArduPilot once it is online
+  public: SyncMode syncMode = SyncMode::LOCKSTEP;
+
+  /// \brief Physics steps per ArduPilot frame
+  public: unsigned int stepsPerFrame = 1;
+
+  /// \brief Physics steps run in the current frame
+  public: unsigned int subStep = 0;
+
+  /// \brief Sum of the IMU angular velocity over the current frame
+  public: ignition::math::Vector3d gyroSum;
+
+  /// \brief Sum of the IMU linear acceleration over the current frame
+  public: ignition::math::Vector3d accelSum;
+
+  /// \brief Number of samples in gyroSum and accelSum
+  public: unsigned int imuSamples = 0;
+
+  /// \brief World lockstep coordinator, if <lockstepBarrier> is set
+  public: std::shared_ptr<LockstepBarrier> barrier;
+
+  /// \brief Wait of the next receive, set by PlanReceive()
+  public: uint32_t recvWaitMs = 0;
+
+  /// \brief true if a missed receive keeps the last command, set by
+  /// PlanReceive()
+  public: bool keepLastCommand = false;
+
+  /// \brief true if PlanReceive() already ran for this step
+  public: bool receivePlanned = false;
+
+  /// \brief true if the barrier already waited for this step's packet
+  public: bool barrierWaited = false;
+
+  /// \brief true if servo packets are read from transport on the
+  /// physics thread, rather than from servoMailbox
+  public: bool ReceivesDirectly() const;
+
+  /// \brief Decide how long the next receive may wait.
+  public: void PlanReceive();
+
+  /// \brief Largest command age in sim time before ASYNC mode waits
+  public: gazebo::common::Time maxStaleness;
+
+  /// \brief Sim time the current servo command was received
+  public: gazebo::common::Time lastCommandTime;
+
+  /// \brief Steps run with a command of the age of the previous step
+  /// or older, ASYNC mode
+  public: uint64_t staleSteps = 0;
+
+  /// \brief Steps run while online, ASYNC mode
+  public: uint64_t asyncSteps = 0;
+
+  /// \brief Sum of the command age over asyncSteps, seconds
+  public: double stalenessSum = 0.0;
+
+  /// \brief Largest command age seen, seconds
+  public: double stalenessMax = 0.0;
+
+  /// \brief Times ASYNC mode waited because maxStaleness was exceeded
+  public: uint64_t stalenessWaits = 0;
+
+  /// \brief true while this plugin holds the world paused waiting for
+  /// ArduPilot
+  public: std::atomic<bool> worldHeld{false};
+
+  /// \brief Pause shared with the other vehicles of the world
+  public: std::shared_ptr<WorldHold> worldHold;
+
+  /// \brief Waits for the first servo packet in PAUSE mode, owns
+  /// transport while running
+  public: std::thread startupThread;
+
+  /// \brief true while startupThread owns transport
+  public: std::atomic<bool> startupWaiting{false};
+
+  /// \brief Release this plugin's hold on the world, resuming it if no
+  /// other vehicle still holds it.
+  public: void ReleaseWorld();
+
+  /// \brief Wait for the first servo packet, publish it to
+  /// servoMailbox and resume the world.
+  public: void RunStartupWaiter();
+
+  /// \brief true if socket I/O runs on a dedicated thread
+  public: bool useIOThread = false;
+
+  /// \brief Network I/O thread, owns transport
+  public: std::thread ioThread;
+
+  /// \brief Request the network I/O thread to exit
+  public: std::atomic<bool> ioThreadStop{false};
+
+  /// \brief true while the I/O thread is about to block in poll
+  public: std::atomic<bool> ioThreadWaiting{false};
+
+  /// \brief Connection status as seen by the I/O thread
+  public: std::atomic<bool> ioArduPilotOnline{false};
+
+  /// \brief Pipe used to wake the I/O thread, [0] read end, [1] write end
+  public: int ioWakePipe[2] = {-1, -1};
+
+  /// \brief Newest servo frame, I/O thread to physics thread
+  public: LatestValueMailbox<ServoFrame> servoMailbox;
+
+  /// \brief Outgoing state packets, physics thread to I/O thread
+  public: SpscQueue<StateFrame, 16> fdmQueue;
+
+  /// \brief CPU the physics thread is pinned to, -1 for no pinning
+  public: int physicsThreadCpu = -1;
+
+  /// \brief CPU the I/O thread is pinned to, -1 for no pinning
+  public: int ioThreadCpu = -1;
+
+  /// \brief true once the physics thread affinity was applied
+  public: bool physicsThreadPinned = false;
+
+  /// \brief Convert a servo packet to control commands.
+  /// \param[in] _frame Servo frame received from ArduPilot.
+  public: void ApplyServoFrame(const ServoFrame &_frame);
+
+  /// \brief Receive the newest servo frame, check its frame number and
+  /// update the drop counters.
+  /// \param[out] _frame Received frame.
+  /// \param[in] _timeoutMs Milliseconds to wait.
+  /// \param[in] _wakeFd Descriptor interrupting the wait, -1 for none.
+  /// \return Servo packet size, 0 if only duplicate or reordered frames
+  /// were received, or -1 if nothing was received.
+  public: ssize_t RecvServoFrame(ServoFrame &_frame,
+      const uint32_t _timeoutMs, const int _wakeFd = -1);
+
+  /// \brief Send a state packet, with its frame header if enabled.
+  /// \param[in] _frame State frame.
+  public: void SendStateFrame(const StateFrame &_frame);
+
+  /// \brief Serialize a state frame as a v2 packet into stateBuffer.
+  /// \param[in] _frame State frame.
+  /// \return Packet size.
+  public: size_t EncodeStateV2(const StateFrame &_frame);
+
+  /// \brief Select the v2 state fields from the sensors found and the
+  /// <stateFields> list.
+  /// \param[in] _sdf Plugin SDF.
+  public: void ConfigureStateFields(sdf::ElementPtr _sdf);
+
+  /// \brief Network I/O thread main loop. Sends queued state packets and
+  /// publishes the newest servo packet to servoMailbox.
+  public: void RunIOThread();
 };
 
+/////////////////////////////////////////////////
+/// \brief Pin the calling thread to one CPU.
+/// \param[in] _cpu CPU index.
+/// \return True on success.
+static bool PinCurrentThread(const int _cpu)
+{
+#ifdef __linux__
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(_cpu, &cpus);
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#else
+  (void)_cpu;
+  return false;
+#endif
+}
+
+/////////////////////////////////////////////////
+/// \brief Monotonic wall clock for the step timings.
+/// \return Nanoseconds since an arbitrary epoch.
+static uint64_t SteadyNs()
+{
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
 /////////////////////////////////////////////////
 ArduPilotPlugin::ArduPilotPlugin()
   : dataPtr(new ArduPilotPluginPrivate)
@@ -381,6 +1939,96 @@ ArduPilotPlugin::ArduPilotPlugin()
 /////////////////////////////////////////////////
 ArduPilotPlugin::~ArduPilotPlugin()
 {
+  if (this->dataPtr->barrier)
+  {
+    this->dataPtr->barrier->Unregister(this);
+  }
+  if (this->dataPtr->startupThread.joinable())
+  {
+    this->dataPtr->ioThreadStop = true;
+    this->dataPtr->startupThread.join();
+  }
+  if (this->dataPtr->ioThread.joinable())
+  {
+    this->dataPtr->ioThreadStop = true;
+    #ifndef _WIN32
+    const char wake = 0;
+    if (write(this->dataPtr->ioWakePipe[1], &wake, 1) < 0)
+    {
+      gzwarn << "[" << this->dataPtr->modelName << "] "
+             << "failed to wake network I/O thread.\n";
+    }
+    #endif
+    this->dataPtr->ioThread.join();
+  }
+  if (this->dataPtr->worldHeld.exchange(false))
+  {
+    // unloaded before ArduPilot connected, stop holding the others back
+    this->dataPtr->worldHold->Release(this->dataPtr->model->GetWorld());
+  }
+
+  if (this->dataPtr->framesReceived > 0)
+  {
+    gzmsg << "[" << this->dataPtr->modelName << "] "
+          << "servo frames: " << this->dataPtr->framesReceived
+          << " received, " << this->dataPtr->framesLost << " lost, "
+          << this->dataPtr->framesDuplicated << " duplicated, "
+          << this->dataPtr->framesReordered << " reordered, "
+          << this->dataPtr->frameRestarts << " restarts.\n";
+  }
+
+  if (this->dataPtr->asyncSteps > 0)
+  {
+    gzmsg << "[" << this->dataPtr->modelName << "] "
+          << "command staleness: mean "
+          << this->dataPtr->stalenessSum / this->dataPtr->asyncSteps
+          << " s, max " << this->dataPtr->stalenessMax << " s, "
+          << this->dataPtr->staleSteps << "/" << this->dataPtr->asyncSteps
+          << " steps on a stale command, " << this->dataPtr->stalenessWaits
+          << " waits.\n";
+  }
+
+  const uint64_t sensorReads = this->dataPtr->imu.reads +
+    this->dataPtr->gps.reads + this->dataPtr->rangefinder.reads +
+    this->dataPtr->baro.reads;
+  const uint64_t sensorReuses = this->dataPtr->imu.reuses +
+    this->dataPtr->gps.reuses + this->dataPtr->rangefinder.reuses +
+    this->dataPtr->baro.reuses;
+  if (sensorReads > 0)
+  {
+    gzmsg << "[" << this->dataPtr->modelName << "] "
+          << "sensor samples: " << sensorReads << " read, "
+          << sensorReuses << " reused unchanged.\n";
+  }
+
+  if (this->dataPtr->sendStateNs.Count() > 0)
+  {
+    gzmsg << "[" << this->dataPtr->modelName << "] "
+          << "step timings:\n" << this->dataPtr->StatsReport();
+  }
+
+  if (this->dataPtr->transport)
+  {
+    const ArduPilotWaitStats stats = this->dataPtr->transport->WaitStats();
+    const uint64_t woken = stats.spinWakeups + stats.blockWakeups;
+    if (woken > 0)
+    {
+      gzmsg << "[" << this->dataPtr->modelName << "] "
+            << "receive waits: " << stats.spinWakeups << " spin, "
+            << stats.blockWakeups << " block ("
+            << (100 * stats.spinWakeups / woken) << "% spin), "
+            << stats.timeouts << " timeouts.\n";
+    }
+  }
+  #ifndef _WIN32
+  for (int i = 0; i < 2; ++i)
+  {
+    if (this->dataPtr->ioWakePipe[i] != -1)
+    {
+      ::close(this->dataPtr->ioWakePipe[i]);
+    }
+  }
+  #endif
 }
 
 /////////////////////////////////////////////////
@@ -462,12 +2110,14 @@ void ArduPilotPlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf)
 
     if (control.type != "VELOCITY" &&
         control.type != "POSITION" &&
-        control.type != "EFFORT")
+        control.type != "EFFORT" &&
+        control.type != "MOTOR" &&
+        control.type != "WRENCH")
     {
       gzwarn << "[" << this->dataPtr->modelName << "] "
              << "Control type [" << control.type
-             << "] not recognized, must be one of VELOCITY, POSITION, EFFORT."
-             << " default to VELOCITY.\n";
+             << "] not recognized, must be one of VELOCITY, POSITION, EFFORT,"
+             << " MOTOR, WRENCH. default to VELOCITY.\n";
       control.type = "VELOCITY";
     }
 
@@ -476,25 +2126,50 @@ void ArduPilotPlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf)
       control.useForce = controlSDF->Get<bool>("useForce");
     }
 
-    if (controlSDF->HasElement("jointName"))
+    control.kinematicSpin = controlSDF->Get("kinematicSpin", false).first;
+    if (control.kinematicSpin)
+    {
+      if (control.type != "MOTOR")
+      {
+        gzwarn << "[" << this->dataPtr->modelName << "] "
+               << "kinematicSpin needs the MOTOR control type, using it"
+               << " for channel [" << control.channel << "].\n";
+        control.type = "MOTOR";
+      }
+      if (!this->dataPtr->LoadKinematicRotor(controlSDF, control))
+      {
+        return;
+      }
+    }
+    else if (control.type == "WRENCH")
     {
-      control.jointName = controlSDF->Get<std::string>("jointName");
+      if (!this->dataPtr->LoadWrench(controlSDF, control))
+      {
+        return;
+      }
     }
     else
     {
-      gzerr << "[" << this->dataPtr->modelName << "] "
-            << "Please specify a jointName,"
-            << " where the control channel is attached.\n";
-    }
+      if (controlSDF->HasElement("jointName"))
+      {
+        control.jointName = controlSDF->Get<std::string>("jointName");
+      }
+      else
+      {
+        gzerr << "[" << this->dataPtr->modelName << "] "
+              << "Please specify a jointName,"
+              << " where the control channel is attached.\n";
+      }
 
-    // Get the pointer to the joint.
-    control.joint = _model->GetJoint(control.jointName);
-    if (control.joint == nullptr)
-    {
-      gzerr << "[" << this->dataPtr->modelName << "] "
-            << "Couldn't find specified joint ["
-            << control.jointName << "]. This plugin will not run.\n";
-      return;
+      // Get the pointer to the joint.
+      control.joint = _model->GetJoint(control.jointName);
+      if (control.joint == nullptr)
+      {
+        gzerr << "[" << this->dataPtr->modelName << "] "
+              << "Couldn't find specified joint ["
+              << control.jointName << "]. This plugin will not run.\n";
+        return;
+      }
     }
 
     if (controlSDF->HasElement("multiplier"))
@@ -556,19 +2231,21 @@ void ArduPilotPlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf)
       control.rotorVelocitySlowdownSim = 1.0;
     }
 
+    // joint state filter, only enabled if a cutoff is given
+    control.filterJointState = controlSDF->HasElement("frequencyCutoff") &&
+      controlSDF->Get<double>("frequencyCutoff") > 0.0;
     control.frequencyCutoff =
           controlSDF->Get("frequencyCutoff", control.frequencyCutoff).first;
     control.samplingRate =
           controlSDF->Get("samplingRate", control.samplingRate).first;
 
-    // use gazebo::math::Filter
-    control.filter.Fc(control.frequencyCutoff, control.samplingRate);
-
-    // initialize filter to zero value
-    control.filter.Set(0.0);
-
-    // note to use this filter, do
-    // stateFiltered = filter.Process(stateRaw);
+    // MOTOR lag, motorTimeConstant sets both directions
+    const double motorTau = controlSDF->Get("motorTimeConstant",
+        control.motorTimeConstantUp).first;
+    control.motorTimeConstantUp = std::max(0.0, controlSDF->Get(
+          "motorTimeConstantUp", motorTau).first);
+    control.motorTimeConstantDown = std::max(0.0, controlSDF->Get(
+          "motorTimeConstantDown", motorTau).first);
 
     // Overload the PID parameters if they are available.
     double param;
@@ -585,526 +2262,1101 @@ void ArduPilotPlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf)
     param = controlSDF->Get("vel_i_max", control.pid.GetIMax()).first;
     control.pid.SetIMax(param);
 
-    param = controlSDF->Get("vel_i_min", control.pid.GetIMin()).first;
-    control.pid.SetIMin(param);
+    param = controlSDF->Get("vel_i_min", control.pid.GetIMin()).first;
+    control.pid.SetIMin(param);
+
+    param = controlSDF->Get("vel_cmd_max", control.pid.GetCmdMax()).first;
+    control.pid.SetCmdMax(param);
+
+    param = controlSDF->Get("vel_cmd_min", control.pid.GetCmdMin()).first;
+    control.pid.SetCmdMin(param);
+
+    // new params, overwrite old params if exist
+    param = controlSDF->Get("p_gain", control.pid.GetPGain()).first;
+    control.pid.SetPGain(param);
+
+    param = controlSDF->Get("i_gain", control.pid.GetIGain()).first;
+    control.pid.SetIGain(param);
+
+    param = controlSDF->Get("d_gain", control.pid.GetDGain()).first;
+    control.pid.SetDGain(param);
+
+    param = controlSDF->Get("i_max", control.pid.GetIMax()).first;
+    control.pid.SetIMax(param);
+
+    param = controlSDF->Get("i_min", control.pid.GetIMin()).first;
+    control.pid.SetIMin(param);
+
+    param = controlSDF->Get("cmd_max", control.pid.GetCmdMax()).first;
+    control.pid.SetCmdMax(param);
+
+    param = controlSDF->Get("cmd_min", control.pid.GetCmdMin()).first;
+    control.pid.SetCmdMin(param);
+
+    // set pid initial command
+    control.pid.SetCmd(0.0);
+
+    this->dataPtr->controls.push_back(control);
+    controlSDF = controlSDF->GetNextElement("control");
+  }
+  this->dataPtr->bank.Compile(this->dataPtr->controls);
+
+  // visuals of the kinematic rotors
+  for (size_t i = 0; i < this->dataPtr->controls.size(); ++i)
+  {
+    const Control &control = this->dataPtr->controls[i];
+    if (!control.kinematicSpin || control.visualName.empty())
+    {
+      continue;
+    }
+    SpinVisual visual;
+    visual.index = i;
+    visual.pose = control.visualPose;
+    visual.msg.set_name(control.visualName);
+    visual.msg.set_parent_name(control.link->GetScopedName());
+    this->dataPtr->spinVisuals.push_back(visual);
+  }
+  const double spinVisualRate = _sdf->Get("spinVisualRate", 30.0).first;
+  if (!this->dataPtr->spinVisuals.empty() && spinVisualRate > 0.0)
+  {
+    this->dataPtr->spinVisualPeriod = 1.0 / spinVisualRate;
+    this->dataPtr->node = transport::NodePtr(new transport::Node());
+    this->dataPtr->node->Init(this->dataPtr->model->GetWorld()->Name());
+    this->dataPtr->visualPub =
+      this->dataPtr->node->Advertise<msgs::Visual>("~/visual");
+  }
+
+  const double statsRate = _sdf->Get("statsRate", 1.0).first;
+  if (statsRate > 0.0)
+  {
+    this->dataPtr->statsPeriod = 1.0 / statsRate;
+    if (!this->dataPtr->node)
+    {
+      this->dataPtr->node = transport::NodePtr(new transport::Node());
+      this->dataPtr->node->Init(this->dataPtr->model->GetWorld()->Name());
+    }
+    this->dataPtr->statsPub =
+      this->dataPtr->node->Advertise<msgs::GzString>(
+          "~/" + this->dataPtr->modelName + "/ardupilot_stats");
+  }
+
+  // Get sensors
+  const std::string imuSource =
+    _sdf->Get("imuSource", std::string("sensor")).first;
+  if (imuSource == "link")
+  {
+    const std::string imuLinkName =
+      _sdf->Get("imuLinkName", std::string()).first;
+    this->dataPtr->imuLink = imuLinkName.empty() ?
+      this->dataPtr->model->GetLink() :
+      this->dataPtr->model->GetLink(imuLinkName);
+    if (!this->dataPtr->imuLink)
+    {
+      gzerr << "[" << this->dataPtr->modelName << "] "
+            << "imu link [" << imuLinkName
+            << "] not found, abort ArduPilot plugin.\n";
+      return;
+    }
+    this->dataPtr->gyroNoise = _sdf->Get("imuGyroNoise", 0.0).first;
+    this->dataPtr->accelNoise = _sdf->Get("imuAccelNoise", 0.0).first;
+    this->dataPtr->gyroBiasWalk =
+      _sdf->Get("imuGyroBiasRandomWalk", 0.0).first;
+    this->dataPtr->accelBiasWalk =
+      _sdf->Get("imuAccelBiasRandomWalk", 0.0).first;
+  }
+  else
+  {
+    if (imuSource != "sensor")
+    {
+      gzwarn << "[" << this->dataPtr->modelName << "] "
+             << "imuSource [" << imuSource << "] not recognized, must be"
+             << " sensor or link. default to sensor.\n";
+    }
+    const std::string imuName =
+      _sdf->Get("imuName", static_cast<std::string>("imu_sensor")).first;
+    if (!this->dataPtr->imu.Bind(this->dataPtr->model, imuName,
+          [](sensors::ImuSensor &_sensor)
+          {
+            return ImuSample{_sensor.LinearAcceleration(),
+                             _sensor.AngularVelocity()};
+          }))
+    {
+      gzerr << "[" << this->dataPtr->modelName << "] "
+            << "imu_sensor [" << imuName
+            << "] not found, abort ArduPilot plugin.\n";
+      return;
+    }
+  }
+  // Optional sensors, only reported with the v2 protocol
+  const std::string gpsName =
+    _sdf->Get("gpsName", static_cast<std::string>("gps_sensor")).first;
+  this->dataPtr->gps.Bind(this->dataPtr->model, gpsName,
+      [](sensors::GpsSensor &_sensor)
+      {
+        return ignition::math::Vector3d(_sensor.Latitude().Degree(),
+            _sensor.Longitude().Degree(), _sensor.Altitude());
+      });
+  const std::string rangefinderName = _sdf->Get("rangefinderName",
+      static_cast<std::string>("rangefinder_sensor")).first;
+  this->dataPtr->rangefinder.Bind(this->dataPtr->model, rangefinderName,
+      [](sensors::RaySensor &_sensor)
+      {
+        // Rangefinder value can not be send as Inf to ardupilot
+        const double range = _sensor.Range(0);
+        return std::isinf(range) ? 0.0 : range;
+      });
+  const std::string baroName =
+    _sdf->Get("baroName", static_cast<std::string>("baro_sensor")).first;
+  this->dataPtr->baro.Bind(this->dataPtr->model, baroName,
+      [](sensors::AltimeterSensor &_sensor)
+      {
+        return _sensor.Altitude();
+      });
+  if (!this->dataPtr->rays.Load(this->dataPtr->model, _sdf,
+        this->dataPtr->modelName))
+  {
+    gzerr << "[" << this->dataPtr->modelName << "] "
+          << "ray sensors failed to load, abort ArduPilot plugin.\n";
+    return;
+  }
+
+  // State and servo packet format
+  const std::string protocol =
+    _sdf->Get("protocol", static_cast<std::string>("legacy")).first;
+  this->dataPtr->protocolV2 = protocol == "v2";
+  if (!this->dataPtr->protocolV2 && protocol != "legacy")
+  {
+    gzwarn << "[" << this->dataPtr->modelName << "] "
+           << "protocol [" << protocol << "] not recognized, must be one of"
+           << " legacy, v2. default to legacy.\n";
+  }
+  if (this->dataPtr->protocolV2)
+  {
+    this->dataPtr->stateFloat32 = _sdf->Get("stateEncoding",
+        static_cast<std::string>("double")).first == "float32";
+    this->dataPtr->ConfigureStateFields(_sdf);
+    for (const auto &control : this->dataPtr->controls)
+    {
+      this->dataPtr->servoChannelCount = std::max(
+          this->dataPtr->servoChannelCount,
+          static_cast<uint16_t>(control.channel + 1));
+    }
+    gzlog << "[" << this->dataPtr->modelName << "] "
+          << "v2 protocol, state field mask 0x" << std::hex
+          << this->dataPtr->stateFieldMask << std::dec << ", "
+          << this->dataPtr->servoChannelCount << " servo channels.\n";
+  }
+
+  // Controller time control.
+  this->dataPtr->lastControllerUpdateTime = 0;
+
+  // Initialise ardupilot sockets
+  if (!InitArduPilotSockets(_sdf))
+  {
+    return;
+  }
+
+  // Missed update count before we declare arduPilotOnline status false
+  this->dataPtr->connectionTimeoutMaxCount =
+    _sdf->Get("connectionTimeoutMaxCount", 10).first;
+
+  // Physics sub-steps per ArduPilot exchange
+  this->dataPtr->stepsPerFrame = std::max(1u,
+      _sdf->Get("physicsStepsPerFrame", 1u).first);
+
+  // Optional frame numbers on servo and state packets
+  this->dataPtr->frameNumbers = _sdf->Get("frameNumbers", false).first;
+  if (this->dataPtr->frameNumbers || this->dataPtr->protocolV2)
+  {
+    // keep the highest frame number of a drained batch
+    this->dataPtr->transport->SetPacketOrder(&NewerServoFrame);
+  }
+
+  const std::string startupMode =
+    _sdf->Get("startupMode", static_cast<std::string>("poll")).first;
+  if (startupMode == "free_run")
+  {
+    this->dataPtr->startupMode = StartupMode::FREE_RUN;
+  }
+  else if (startupMode == "block")
+  {
+    this->dataPtr->startupMode = StartupMode::BLOCK;
+  }
+  else if (startupMode == "pause")
+  {
+    this->dataPtr->startupMode = StartupMode::PAUSE;
+  }
+  else if (startupMode != "poll")
+  {
+    gzwarn << "[" << this->dataPtr->modelName << "] "
+           << "startupMode [" << startupMode << "] not recognized, must be"
+           << " one of poll, free_run, block, pause. default to poll.\n";
+  }
+
+  const std::string syncMode =
+    _sdf->Get("syncMode", static_cast<std::string>("lockstep")).first;
+  if (syncMode == "async")
+  {
+    this->dataPtr->syncMode = SyncMode::ASYNC;
+  }
+  else if (syncMode != "lockstep")
+  {
+    gzwarn << "[" << this->dataPtr->modelName << "] "
+           << "syncMode [" << syncMode << "] not recognized, must be one of"
+           << " lockstep, async. default to lockstep.\n";
+  }
+  this->dataPtr->maxStaleness = _sdf->Get("maxStaleness", 0.02).first;
+
+  // Receive timeout bounds while ArduPilot is online
+  this->dataPtr->replyTimeout.Configure(
+      _sdf->Get("timeoutSigma", 4.0).first,
+      _sdf->Get("minTimeoutMs", 1u).first,
+      _sdf->Get("maxTimeoutMs", 1000u).first);
+
+  // Thread placement, applied from the threads themselves
+  this->dataPtr->physicsThreadCpu = _sdf->Get("physicsThreadCpu", -1).first;
+  this->dataPtr->ioThreadCpu = _sdf->Get("ioThreadCpu", -1).first;
+
+  // Optionally move socket I/O off the physics thread
+  this->dataPtr->useIOThread = _sdf->Get("ioThread", false).first;
+  if (this->dataPtr->useIOThread &&
+      !this->dataPtr->transport->SupportsWakeFd())
+  {
+    gzwarn << "[" << this->dataPtr->modelName << "] "
+           << "<ioThread> has no effect with ["
+           << this->dataPtr->transport_type << "] transport.\n";
+    this->dataPtr->useIOThread = false;
+  }
+  #ifndef _WIN32
+  if (this->dataPtr->useIOThread)
+  {
+    if (pipe(this->dataPtr->ioWakePipe) != 0)
+    {
+      gzerr << "[" << this->dataPtr->modelName << "] "
+            << "failed to create I/O thread wake pipe, aborting plugin.\n";
+      return;
+    }
+    for (int i = 0; i < 2; ++i)
+    {
+      fcntl(this->dataPtr->ioWakePipe[i], F_SETFD, FD_CLOEXEC);
+      fcntl(this->dataPtr->ioWakePipe[i], F_SETFL,
+          fcntl(this->dataPtr->ioWakePipe[i], F_GETFL, 0) | O_NONBLOCK);
+    }
+    this->dataPtr->ioThread =
+      std::thread(&ArduPilotPluginPrivate::RunIOThread, this->dataPtr.get());
+  }
+  #endif
+
+  // Hold the world until ArduPilot shows up, the I/O thread or a
+  // dedicated waiter releases it.
+  if (this->dataPtr->startupMode == StartupMode::PAUSE)
+  {
+    this->dataPtr->worldHold =
+      WorldHold::Get(this->dataPtr->model->GetWorld()->Name());
+    this->dataPtr->worldHeld =
+      this->dataPtr->worldHold->Acquire(this->dataPtr->model->GetWorld());
+  }
+  if (this->dataPtr->worldHeld)
+  {
+    if (!this->dataPtr->useIOThread)
+    {
+      this->dataPtr->startupWaiting = true;
+      this->dataPtr->startupThread = std::thread(
+          &ArduPilotPluginPrivate::RunStartupWaiter, this->dataPtr.get());
+    }
+    gzmsg << "[" << this->dataPtr->modelName << "] "
+          << "world paused until ArduPilot connects.\n";
+  }
+
+  // Listen to the update event. This event is broadcast every simulation
+  // iteration.
+  if (_sdf->Get("lockstepBarrier", false).first)
+  {
+    // step together with the other vehicles of the world
+    LockstepBarrier::Member member;
+    member.prepare = [this](int &_fd, uint32_t &_waitMs)
+    {
+      std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+      _fd = -1;
+      _waitMs = 0;
+      if (this->dataPtr->model->GetWorld()->SimTime() >
+          this->dataPtr->lastControllerUpdateTime &&
+          this->dataPtr->subStep == 0 &&
+          this->dataPtr->ReceivesDirectly())
+      {
+        this->dataPtr->PlanReceive();
+        _waitMs = this->dataPtr->recvWaitMs;
+        _fd = _waitMs > 0 ? this->dataPtr->transport->ReadableFd() : -1;
+      }
+    };
+    member.step = [this](const bool _waited)
+    {
+      this->dataPtr->barrierWaited = _waited;
+      this->OnUpdate();
+    };
+    this->dataPtr->barrier =
+      LockstepBarrier::Get(this->dataPtr->model->GetWorld()->Name());
+    this->dataPtr->barrier->Register(this, member);
+  }
+  else
+  {
+    this->dataPtr->updateConnection = event::Events::ConnectWorldUpdateBegin(
+        std::bind(&ArduPilotPlugin::OnUpdate, this));
+  }
+
+  gzlog << "[" << this->dataPtr->modelName << "] "
+        << "ArduPilot ready to fly. The force will be with you" << std::endl;
+}
+
+/////////////////////////////////////////////////
+void ArduPilotPlugin::OnUpdate()
+{
+  AP_TRACE_SCOPE("ArduPilotPlugin::OnUpdate");
+  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+
+  if (!this->dataPtr->physicsThreadPinned)
+  {
+    this->dataPtr->physicsThreadPinned = true;
+    if (this->dataPtr->physicsThreadCpu >= 0 &&
+        !PinCurrentThread(this->dataPtr->physicsThreadCpu))
+    {
+      gzwarn << "[" << this->dataPtr->modelName << "] "
+             << "failed to pin physics thread to CPU "
+             << this->dataPtr->physicsThreadCpu << ".\n";
+    }
+  }
+
+  const gazebo::common::Time curTime =
+    this->dataPtr->model->GetWorld()->SimTime();
+
+  // Update the control surfaces and publish the new state.
+  if (curTime > this->dataPtr->lastControllerUpdateTime)
+  {
+    // ArduPilot is only talked to on frame boundaries, sub-steps hold
+    // the last command.
+    const bool frameStart = this->dataPtr->subStep == 0;
+    if (frameStart)
+    {
+      this->ReceiveMotorCommand();
+    }
+    if (frameStart && this->dataPtr->arduPilotOnline &&
+        this->dataPtr->syncMode == SyncMode::ASYNC)
+    {
+      const double staleness =
+        (curTime - this->dataPtr->lastCommandTime).Double();
+      if (this->dataPtr->lastCommandTime <
+          this->dataPtr->lastControllerUpdateTime)
+      {
+        ++this->dataPtr->staleSteps;
+      }
+      ++this->dataPtr->asyncSteps;
+      this->dataPtr->stalenessSum += staleness;
+      this->dataPtr->stalenessMax =
+        std::max(this->dataPtr->stalenessMax, staleness);
+    }
+    if (this->dataPtr->arduPilotOnline)
+    {
+      const uint64_t forcesStart = SteadyNs();
+      this->ApplyMotorForces((curTime -
+        this->dataPtr->lastControllerUpdateTime).Double());
+      this->dataPtr->motorForcesNs.Add(SteadyNs() - forcesStart);
+      this->dataPtr->PublishSpinVisuals(curTime);
+      if (this->dataPtr->stepsPerFrame > 1)
+      {
+        ignition::math::Vector3d accel;
+        ignition::math::Vector3d gyro;
+        this->dataPtr->ReadImu(accel, gyro);
+        this->dataPtr->gyroSum += gyro;
+        this->dataPtr->accelSum += accel;
+        ++this->dataPtr->imuSamples;
+      }
+      if (++this->dataPtr->subStep >= this->dataPtr->stepsPerFrame)
+      {
+        this->dataPtr->subStep = 0;
+        const uint64_t sendStart = SteadyNs();
+        this->SendState();
+        this->dataPtr->sendStateNs.Add(SteadyNs() - sendStart);
+      }
+    }
+    else
+    {
+      this->dataPtr->subStep = 0;
+    }
+  }
+
+  this->dataPtr->PublishStats(curTime);
+  this->dataPtr->lastControllerUpdateTime = curTime;
+}
 
-    param = controlSDF->Get("vel_cmd_max", control.pid.GetCmdMax()).first;
-    control.pid.SetCmdMax(param);
+/////////////////////////////////////////////////
+void ArduPilotPlugin::ResetPIDs()
+{
+  // Reset velocity PID for controls
+  this->dataPtr->bank.ResetCommands();
+}
 
-    param = controlSDF->Get("vel_cmd_min", control.pid.GetCmdMin()).first;
-    control.pid.SetCmdMin(param);
+/////////////////////////////////////////////////
+bool ArduPilotPlugin::InitArduPilotSockets(sdf::ElementPtr _sdf) const
+{
+  this->dataPtr->transport_type =
+    _sdf->Get("transport", static_cast<std::string>("udp")).first;
+  this->dataPtr->fdm_port_in =
+    _sdf->Get("fdm_port_in", static_cast<uint32_t>(9002)).first;
+  this->dataPtr->fdm_port_out =
+    _sdf->Get("fdm_port_out", static_cast<uint32_t>(9003)).first;
 
-    // new params, overwrite old params if exist
-    param = controlSDF->Get("p_gain", control.pid.GetPGain()).first;
-    control.pid.SetPGain(param);
+  // Default addresses depend on the address format of the transport
+  const std::string portIn = std::to_string(this->dataPtr->fdm_port_in);
+  const std::string portOut = std::to_string(this->dataPtr->fdm_port_out);
+  std::string defaultListenAddr = "127.0.0.1";
+  std::string defaultFdmAddr = "127.0.0.1";
+  if (this->dataPtr->transport_type == "unix" ||
+      this->dataPtr->transport_type == "unix_seqpacket")
+  {
+    defaultListenAddr = "@ardupilot_gazebo_" + portIn;
+    defaultFdmAddr = "@ardupilot_sitl_" + portOut;
+  }
+  else if (this->dataPtr->transport_type == "shm")
+  {
+    defaultListenAddr = "/ardupilot_gazebo_" + portIn;
+    defaultFdmAddr = defaultListenAddr;
+    if (_sdf->HasElement("shm_name"))
+    {
+      defaultListenAddr = _sdf->Get<std::string>("shm_name");
+    }
+  }
+  else if (this->dataPtr->transport_type == "inprocess")
+  {
+    defaultListenAddr = _sdf->Get("sitl_library",
+        static_cast<std::string>("libArduPilotSITL.so")).first;
+    defaultFdmAddr =
+      _sdf->Get("sitl_args", static_cast<std::string>("")).first;
+  }
 
-    param = controlSDF->Get("i_gain", control.pid.GetIGain()).first;
-    control.pid.SetIGain(param);
+  this->dataPtr->fdm_addr =
+    _sdf->Get("fdm_addr", defaultFdmAddr).first;
+  this->dataPtr->listen_addr =
+    _sdf->Get("listen_addr", defaultListenAddr).first;
 
-    param = controlSDF->Get("d_gain", control.pid.GetDGain()).first;
-    control.pid.SetDGain(param);
+  // mux packets carry the id in 16 bits, larger ids would alias
+  const uint32_t vehicleId = _sdf->Get("vehicle_id", 0u).first;
+  if (vehicleId > UINT16_MAX)
+  {
+    gzerr << "[" << this->dataPtr->modelName << "] "
+          << "<vehicle_id> " << vehicleId << " is above "
+          << UINT16_MAX << ", aborting plugin.\n";
+    return false;
+  }
+  this->dataPtr->transport = ArduPilotTransport::Create(
+      this->dataPtr->transport_type, static_cast<uint16_t>(vehicleId));
+  if (!this->dataPtr->transport)
+  {
+    gzwarn << "[" << this->dataPtr->modelName << "] "
+           << "transport [" << this->dataPtr->transport_type
+           << "] not recognized, must be one of"
+           << " udp, unix, unix_seqpacket, shm, mux, inprocess."
+           << " default to udp.\n";
+    this->dataPtr->transport_type = "udp";
+    this->dataPtr->transport = ArduPilotTransport::Create("udp");
+  }
 
-    param = controlSDF->Get("i_max", control.pid.GetIMax()).first;
-    control.pid.SetIMax(param);
+  ArduPilotTransportTuning tuning;
+  tuning.spinUs = _sdf->Get("recvSpinUs", 0u).first;
+  tuning.busyPollUs = _sdf->Get("busyPollUs", 0).first;
+  tuning.recvBufferSize = _sdf->Get("socketRecvBufferSize", 0).first;
+  tuning.sendBufferSize = _sdf->Get("socketSendBufferSize", 0).first;
+  tuning.priority = _sdf->Get("socketPriority", -1).first;
+  this->dataPtr->transport->Configure(tuning);
 
-    param = controlSDF->Get("i_min", control.pid.GetIMin()).first;
-    control.pid.SetIMin(param);
+  if (!this->dataPtr->transport->Bind(this->dataPtr->listen_addr,
+      this->dataPtr->fdm_port_in))
+  {
+    gzerr << "[" << this->dataPtr->modelName << "] "
+          << "failed to bind with " << this->dataPtr->listen_addr
+          << ":" << this->dataPtr->fdm_port_in << " aborting plugin."
+          << (this->dataPtr->transport_type == "shm" ?
+              " Is the segment held by another running simulator?" : "")
+          << "\n";
+    return false;
+  }
 
-    param = controlSDF->Get("cmd_max", control.pid.GetCmdMax()).first;
-    control.pid.SetCmdMax(param);
+  if (!this->dataPtr->transport->Connect(this->dataPtr->fdm_addr,
+      this->dataPtr->fdm_port_out))
+  {
+    gzerr << "[" << this->dataPtr->modelName << "] "
+          << "failed to bind with " << this->dataPtr->fdm_addr
+          << ":" << this->dataPtr->fdm_port_out << " aborting plugin.\n";
+    return false;
+  }
 
-    param = controlSDF->Get("cmd_min", control.pid.GetCmdMin()).first;
-    control.pid.SetCmdMin(param);
+  gzlog << "[" << this->dataPtr->modelName << "] "
+        << "using [" << this->dataPtr->transport_type << "] transport, "
+        << "listening on " << this->dataPtr->listen_addr
+        << ", sending to " << this->dataPtr->fdm_addr << ".\n";
+  return true;
+}
 
-    // set pid initial command
-    control.pid.SetCmd(0.0);
+/////////////////////////////////////////////////
+void ArduPilotPlugin::ApplyMotorForces(const double _dt)
+{
+  AP_TRACE_SCOPE("ArduPilotPlugin::ApplyMotorForces");
+  // update velocity PID for controls and apply force to joint
+  this->dataPtr->bank.Update(_dt);
+}
 
-    this->dataPtr->controls.push_back(control);
-    controlSDF = controlSDF->GetNextElement("control");
+/////////////////////////////////////////////////
+bool ArduPilotPluginPrivate::LoadKinematicRotor(sdf::ElementPtr _sdf,
+    Control &_control)
+{
+  const std::string linkName =
+    _sdf->Get("linkName", std::string()).first;
+  _control.link = this->model->GetLink(linkName);
+  if (_control.link == nullptr)
+  {
+    gzerr << "[" << this->modelName << "] "
+          << "Couldn't find kinematic rotor link [" << linkName
+          << "]. This plugin will not run.\n";
+    return false;
   }
 
-  // Get sensors
-  std::string imuName =
-    _sdf->Get("imuName", static_cast<std::string>("imu_sensor")).first;
-  std::vector<std::string> imuScopedName =
-    this->dataPtr->model->SensorScopedName(imuName);
-
-  if (imuScopedName.size() > 1)
+  // the rotor sits where its visual is unless given explicitly
+  const std::string visualName =
+    _sdf->Get("visualName", std::string()).first;
+  if (!visualName.empty())
   {
-    gzwarn << "[" << this->dataPtr->modelName << "] "
-           << "multiple names match [" << imuName << "] using first found"
-           << " name.\n";
-    for (unsigned k = 0; k < imuScopedName.size(); ++k)
+    _control.visualName =
+      _control.link->GetScopedName() + "::" + visualName;
+    const msgs::Visual visual =
+      _control.link->GetVisualMessage(_control.visualName);
+    if (visual.name() != _control.visualName)
+    {
+      gzerr << "[" << this->modelName << "] "
+            << "Couldn't find visual [" << visualName << "] on link ["
+            << linkName << "]. This plugin will not run.\n";
+      return false;
+    }
+    if (visual.has_pose())
     {
-      gzwarn << "  sensor " << k << " [" << imuScopedName[k] << "].\n";
+      _control.visualPose = msgs::ConvertIgn(visual.pose());
     }
+    _control.rotorPose = _control.visualPose;
   }
+  _control.rotorPose =
+    _sdf->Get("rotorPose", _control.rotorPose).first;
+
+  _control.thrustCoefficient =
+    _sdf->Get("thrustCoefficient", _control.thrustCoefficient).first;
+  _control.torqueCoefficient =
+    _sdf->Get("torqueCoefficient", _control.torqueCoefficient).first;
+  return true;
+}
 
-  if (imuScopedName.size() > 0)
+/////////////////////////////////////////////////
+bool ArduPilotPluginPrivate::LoadWrench(sdf::ElementPtr _sdf,
+    Control &_control)
+{
+  const std::string linkName =
+    _sdf->Get("linkName", std::string()).first;
+  _control.link = linkName.empty() ?
+    this->model->GetLink() : this->model->GetLink(linkName);
+  if (_control.link == nullptr)
   {
-    this->dataPtr->imuSensor = std::dynamic_pointer_cast<sensors::ImuSensor>
-      (sensors::SensorManager::Instance()->GetSensor(imuScopedName[0]));
+    gzerr << "[" << this->modelName << "] "
+          << "Couldn't find wrench link [" << linkName
+          << "]. This plugin will not run.\n";
+    return false;
   }
 
-  if (!this->dataPtr->imuSensor)
+  // mixer column "fx fy fz tx ty tz"
+  std::vector<double> column;
+  if (_sdf->HasElement("wrench"))
   {
-    if (imuScopedName.size() > 1)
+    std::istringstream stream(_sdf->Get<std::string>("wrench"));
+    double value;
+    while (stream >> value)
     {
-      gzwarn << "[" << this->dataPtr->modelName << "] "
-             << "first imu_sensor scoped name [" << imuScopedName[0]
-             << "] not found, trying the rest of the sensor names.\n";
-      for (unsigned k = 1; k < imuScopedName.size(); ++k)
-      {
-        this->dataPtr->imuSensor = std::dynamic_pointer_cast<sensors::ImuSensor>
-          (sensors::SensorManager::Instance()->GetSensor(imuScopedName[k]));
-        if (this->dataPtr->imuSensor)
-        {
-          gzwarn << "found [" << imuScopedName[k] << "]\n";
-          break;
-        }
-      }
+      column.push_back(value);
     }
+  }
+  if (column.size() != 6)
+  {
+    gzerr << "[" << this->modelName << "] "
+          << "<wrench> of channel [" << _control.channel
+          << "] needs 6 values, fx fy fz tx ty tz. This plugin will not"
+          << " run.\n";
+    return false;
+  }
+  _control.wrenchForce.Set(column[0], column[1], column[2]);
+  _control.wrenchTorque.Set(column[3], column[4], column[5]);
+  return true;
+}
 
-    if (!this->dataPtr->imuSensor)
-    {
-      gzwarn << "[" << this->dataPtr->modelName << "] "
-             << "imu_sensor scoped name [" << imuName
-             << "] not found, trying unscoped name.\n" << "\n";
-      // TODO: this fails for multi-nested models.
-      // TODO: and transforms fail for rotated nested model,
-      //       joints point the wrong way.
-      this->dataPtr->imuSensor = std::dynamic_pointer_cast<sensors::ImuSensor>
-        (sensors::SensorManager::Instance()->GetSensor(imuName));
-    }
+/////////////////////////////////////////////////
+std::string ArduPilotPluginPrivate::StatsReport() const
+{
+  std::ostringstream report;
+  const auto line = [&report](const char *_name,
+      const LogHistogram &_hist, const double _scale)
+  {
+    report << _name << " n " << _hist.Count()
+           << " mean " << _hist.Mean() * _scale
+           << " p50 " << _hist.Percentile(0.5) * _scale
+           << " p90 " << _hist.Percentile(0.9) * _scale
+           << " p99 " << _hist.Percentile(0.99) * _scale
+           << " max " << _hist.Max() * _scale << "\n";
+  };
+  line("recv_wait_us", this->recvWaitNs, 1e-3);
+  line("motor_forces_us", this->motorForcesNs, 1e-3);
+  line("send_state_us", this->sendStateNs, 1e-3);
+  line("drained_packets", this->drainedPackets, 1.0);
+  report << "recv_timeouts " << this->recvTimeouts << "\n";
+  return report.str();
+}
 
-    if (!this->dataPtr->imuSensor)
-    {
-      gzerr << "[" << this->dataPtr->modelName << "] "
-            << "imu_sensor [" << imuName
-            << "] not found, abort ArduPilot plugin.\n" << "\n";
-      return;
-    }
+/////////////////////////////////////////////////
+void ArduPilotPluginPrivate::PublishStats(const common::Time &_now)
+{
+  // a world reset moves sim time backwards
+  const double elapsed = (_now - this->lastStatsTime).Double();
+  if (!this->statsPub ||
+      (elapsed >= 0.0 && elapsed < this->statsPeriod))
+  {
+    return;
   }
-/* NOT MERGED IN MASTER YET
-    // Get GPS
-  std::string gpsName = _sdf->Get("imuName", static_cast<std::string>("gps_sensor")).first;
-  std::vector<std::string> gpsScopedName = SensorScopedName(this->dataPtr->model, gpsName);
-  if (gpsScopedName.size() > 1)
+  this->lastStatsTime = _now;
+
+  msgs::GzString msg;
+  msg.set_data(this->StatsReport());
+  this->statsPub->Publish(msg);
+}
+
+/////////////////////////////////////////////////
+void ArduPilotPluginPrivate::PublishSpinVisuals(const common::Time &_now)
+{
+  // a world reset moves sim time backwards
+  const double elapsed = (_now - this->lastSpinVisualTime).Double();
+  if (!this->visualPub ||
+      (elapsed >= 0.0 && elapsed < this->spinVisualPeriod))
   {
-    gzwarn << "[" << this->dataPtr->modelName << "] "
-           << "multiple names match [" << gpsName << "] using first found"
-           << " name.\n";
-    for (unsigned k = 0; k < gpsScopedName.size(); ++k)
-    {
-      gzwarn << "  sensor " << k << " [" << gpsScopedName[k] << "].\n";
-    }
+    return;
   }
+  this->lastSpinVisualTime = _now;
 
-  if (gpsScopedName.size() > 0)
+  for (auto &visual : this->spinVisuals)
   {
-    this->dataPtr->gpsSensor = std::dynamic_pointer_cast<sensors::GpsSensor>
-      (sensors::SensorManager::Instance()->GetSensor(gpsScopedName[0]));
+    const ignition::math::Quaterniond spin(
+        ignition::math::Vector3d::UnitZ, this->bank.phase[visual.index]);
+    msgs::Set(visual.msg.mutable_pose(), ignition::math::Pose3d(
+          visual.pose.Pos(), visual.pose.Rot() * spin));
+    this->visualPub->Publish(visual.msg);
   }
+}
+
+/////////////////////////////////////////////////
+void ArduPilotPlugin::ReceiveMotorCommand()
+{
+  AP_TRACE_SCOPE("ArduPilotPlugin::ReceiveMotorCommand");
+  // Added detection for whether ArduPilot is online or not.
+  // If ArduPilot is detected (receive of fdm packet from someone),
+  // then socket receive wait time follows the observed reply interval,
+  // backing off up to maxTimeoutMs on consecutive misses.
+  // If ArduPilot is not detected, receive call blocks for 1ms
+  // on each call.
+  // Once ArduPilot presence is detected, it takes this many
+  // missed receives at maxTimeoutMs before declaring the FCS offline.
 
-  if (!this->dataPtr->gpsSensor)
+  if (this->dataPtr->useIOThread)
   {
-    if (gpsScopedName.size() > 1)
+    // The I/O thread owns the socket, just pick up its newest frame.
+    const ServoFrame *frame = this->dataPtr->servoMailbox.Read();
+    if (frame)
     {
-      gzwarn << "[" << this->dataPtr->modelName << "] "
-             << "first gps_sensor scoped name [" << gpsScopedName[0]
-             << "] not found, trying the rest of the sensor names.\n";
-      for (unsigned k = 1; k < gpsScopedName.size(); ++k)
-      {
-        this->dataPtr->gpsSensor = std::dynamic_pointer_cast<sensors::GpsSensor>
-          (sensors::SensorManager::Instance()->GetSensor(gpsScopedName[k]));
-        if (this->dataPtr->gpsSensor)
-        {
-          gzwarn << "found [" << gpsScopedName[k] << "]\n";
-          break;
-        }
-      }
+      this->dataPtr->ApplyServoFrame(*frame);
     }
-
-    if (!this->dataPtr->gpsSensor)
+    else if (this->dataPtr->arduPilotOnline &&
+        !this->dataPtr->ioArduPilotOnline)
     {
+      this->dataPtr->arduPilotOnline = false;
       gzwarn << "[" << this->dataPtr->modelName << "] "
-             << "gps_sensor scoped name [" << gpsName
-             << "] not found, trying unscoped name.\n" << "\n";
-      this->dataPtr->gpsSensor = std::dynamic_pointer_cast<sensors::GpsSensor>
-        (sensors::SensorManager::Instance()->GetSensor(gpsName));
+             << "Broken ArduPilot connection, resetting motor control.\n";
+      this->ResetPIDs();
     }
+    return;
+  }
 
-    if (!this->dataPtr->gpsSensor)
+  if (this->dataPtr->startupMode == StartupMode::PAUSE &&
+      !this->dataPtr->arduPilotOnline)
+  {
+    // The startup waiter owns the socket until the first packet, which
+    // it hands over through the mailbox.
+    const ServoFrame *frame = this->dataPtr->servoMailbox.Read();
+    if (frame)
     {
-      gzwarn << "[" << this->dataPtr->modelName << "] "
-             << "gps [" << gpsName
-             << "] not found, skipping gps support.\n" << "\n";
+      this->dataPtr->ApplyServoFrame(*frame);
+      return;
     }
-    else
+    if (this->dataPtr->startupWaiting)
     {
-      gzwarn << "[" << this->dataPtr->modelName << "] "
-             << "  found "  << " [" << gpsName << "].\n";
+      return;
     }
   }
 
-  // Get Rangefinder
-  // TODO add sonar
-  std::string rangefinderName = _sdf->Get("rangefinderName",
-    static_cast<std::string>("rangefinder_sensor")).first;
-  std::vector<std::string> rangefinderScopedName = SensorScopedName(this->dataPtr->model, rangefinderName);
-  if (rangefinderScopedName.size() > 1)
+  if (!this->dataPtr->receivePlanned)
   {
-    gzwarn << "[" << this->dataPtr->modelName << "] "
-           << "multiple names match [" << rangefinderName << "] using first found"
-           << " name.\n";
-    for (unsigned k = 0; k < rangefinderScopedName.size(); ++k)
-    {
-      gzwarn << "  sensor " << k << " [" << rangefinderScopedName[k] << "].\n";
-    }
+    this->dataPtr->PlanReceive();
   }
-
-  if (rangefinderScopedName.size() > 0)
+  this->dataPtr->receivePlanned = false;
+  const uint32_t waitMs = this->dataPtr->recvWaitMs;
+  const bool keepLastCommand = this->dataPtr->keepLastCommand;
+
+  // Nothing left to wait for if the lockstep barrier already did.
+  const bool waited = this->dataPtr->barrierWaited;
+  this->dataPtr->barrierWaited = false;
+
+  // Drain the socket in the case we're backed up, keeping the newest
+  ServoFrame frame;
+  const uint64_t recvStart = SteadyNs();
+  const ssize_t recvSize =
+    this->dataPtr->RecvServoFrame(frame, waited ? 0 : waitMs);
+  this->dataPtr->recvWaitNs.Add(SteadyNs() - recvStart);
+
+  if (recvSize == 0)
   {
-    this->dataPtr->rangefinderSensor = std::dynamic_pointer_cast<sensors::RaySensor>
-      (sensors::SensorManager::Instance()->GetSensor(rangefinderScopedName[0]));
+    // a duplicate or reordered frame, the link is alive but there is no
+    // new command: not a miss
+    return;
   }
-
-  if (!this->dataPtr->rangefinderSensor)
+  if (recvSize == -1)
   {
-    if (rangefinderScopedName.size() > 1)
+    // didn't receive a packet
+    // gzdbg << "no packet\n";
+    if (keepLastCommand)
+    {
+      return;
+    }
+    if (this->dataPtr->arduPilotOnline)
     {
+      if (waitMs > 0)
+      {
+        ++this->dataPtr->recvTimeouts;
+      }
+      const bool fullTimeout = this->dataPtr->replyTimeout.AtMax();
+      this->dataPtr->replyTimeout.AddMiss();
+      if (!fullTimeout)
+      {
+        // a late or lost reply, retry with a longer timeout
+        gzdbg << "[" << this->dataPtr->modelName << "] "
+              << "no reply within " << waitMs << " ms, backing off.\n";
+        return;
+      }
       gzwarn << "[" << this->dataPtr->modelName << "] "
-             << "first rangefinder_sensor scoped name [" << rangefinderScopedName[0]
-             << "] not found, trying the rest of the sensor names.\n";
-      for (unsigned k = 1; k < rangefinderScopedName.size(); ++k)
+             << "Broken ArduPilot connection, count ["
+             << this->dataPtr->connectionTimeoutCount
+             << "/" << this->dataPtr->connectionTimeoutMaxCount
+             << "]\n";
+      if (++this->dataPtr->connectionTimeoutCount >
+        this->dataPtr->connectionTimeoutMaxCount)
       {
-        this->dataPtr->rangefinderSensor = std::dynamic_pointer_cast<sensors::RaySensor>
-          (sensors::SensorManager::Instance()->GetSensor(rangefinderScopedName[k]));
-        if (this->dataPtr->rangefinderSensor)
-        {
-          gzwarn << "found [" << rangefinderScopedName[k] << "]\n";
-          break;
-        }
+        this->dataPtr->connectionTimeoutCount = 0;
+        this->dataPtr->arduPilotOnline = false;
+        this->dataPtr->replyTimeout.Reset();
+        gzwarn << "[" << this->dataPtr->modelName << "] "
+               << "Broken ArduPilot connection, resetting motor control.\n";
+        this->ResetPIDs();
       }
     }
-
-    if (!this->dataPtr->rangefinderSensor)
+  }
+  else
+  {
+    if (this->dataPtr->awaitingReply)
     {
-      gzwarn << "[" << this->dataPtr->modelName << "] "
-             << "rangefinder_sensor scoped name [" << rangefinderName
-             << "] not found, trying unscoped name.\n" << "\n";
-      /// TODO: this fails for multi-nested models.
-      /// TODO: and transforms fail for rotated nested model,
-      ///       joints point the wrong way.
-      this->dataPtr->rangefinderSensor = std::dynamic_pointer_cast<sensors::RaySensor>
-        (sensors::SensorManager::Instance()->GetSensor(rangefinderName));
+      this->dataPtr->awaitingReply = false;
+      this->dataPtr->replyTimeout.AddSample(
+          std::chrono::duration<double>(std::chrono::steady_clock::now() -
+            this->dataPtr->lastSendTime).count());
     }
-    if (!this->dataPtr->rangefinderSensor)
+    this->dataPtr->connectionTimeoutCount = 0;
+    this->dataPtr->ApplyServoFrame(frame);
+  }
+}
+
+/////////////////////////////////////////////////
+ssize_t ArduPilotPluginPrivate::RecvServoFrame(ServoFrame &_frame,
+    const uint32_t _timeoutMs, const int _wakeFd)
+{
+  static_assert(offsetof(ServoFrame, pkt) == sizeof(FrameHeader),
+      "frame header and servo packet must be contiguous");
+
+  uint32_t dropped = 0;
+  _frame.numbered = false;
+  _frame.dropped = 0;
+  if (!this->frameNumbers && !this->protocolV2)
+  {
+    _frame.size = this->transport->RecvLatest(&_frame.pkt,
+        sizeof(_frame.pkt), _timeoutMs, dropped, _wakeFd);
+  }
+  else
+  {
+    _frame.size = this->transport->RecvLatest(&_frame.header,
+        sizeof(_frame.header) + sizeof(_frame.pkt), _timeoutMs, dropped,
+        _wakeFd);
+    if (_frame.size >= static_cast<ssize_t>(sizeof(_frame.header)) &&
+        (_frame.header.magic == kFrameMagic ||
+         _frame.header.magic == kServoV2Magic))
     {
-      gzwarn << "[" << this->dataPtr->modelName << "] "
-             << "ranfinder [" << rangefinderName
-             << "] not found, skipping rangefinder support.\n" << "\n";
+      _frame.numbered = true;
+      _frame.size -= sizeof(_frame.header);
     }
-    else
+    else if (_frame.size > 0)
     {
-      gzwarn << "[" << this->dataPtr->modelName << "] "
-             << "  found "  << " [" << rangefinderName << "].\n";
+      // unnumbered packet from an older ArduPilot, shift it in place
+      memmove(_frame.pkt.motorSpeed,
+          reinterpret_cast<const char *>(&_frame.header), std::min(
+            static_cast<size_t>(_frame.size), sizeof(_frame.pkt)));
     }
   }
-*/
-  // Controller time control.
-  this->dataPtr->lastControllerUpdateTime = 0;
 
-  // Initialise ardupilot sockets
-  if (!InitArduPilotSockets(_sdf))
+  if (_frame.size <= 0)
   {
-    return;
+    return -1;
   }
 
-  // Missed update count before we declare arduPilotOnline status false
-  this->dataPtr->connectionTimeoutMaxCount =
-    _sdf->Get("connectionTimeoutMaxCount", 10).first;
-
-  // Listen to the update event. This event is broadcast every simulation
-  // iteration.
-  this->dataPtr->updateConnection = event::Events::ConnectWorldUpdateBegin(
-      std::bind(&ArduPilotPlugin::OnUpdate, this));
-
-  gzlog << "[" << this->dataPtr->modelName << "] "
-        << "ArduPilot ready to fly. The force will be with you" << std::endl;
-}
-
-/////////////////////////////////////////////////
-void ArduPilotPlugin::OnUpdate()
-{
-  std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
+  if (dropped > 0)
+  {
+    _frame.dropped = dropped;
+    this->droppedPacketCount += dropped;
+    gzdbg << "[" << this->modelName << "] "
+          << "Drained n packets: " << dropped
+          << ", total dropped: " << this->droppedPacketCount
+          << std::endl;
+  }
 
-  const gazebo::common::Time curTime =
-    this->dataPtr->model->GetWorld()->SimTime();
+  if (!_frame.numbered)
+  {
+    return _frame.size;
+  }
 
-  // Update the control surfaces and publish the new state.
-  if (curTime > this->dataPtr->lastControllerUpdateTime)
+  const uint32_t number = _frame.header.frameNumber;
+  const int32_t delta =
+    static_cast<int32_t>(number - this->lastFrameNumber);
+  ++this->framesReceived;
+  if (!this->hasFrameNumber || delta < -kReorderWindow)
   {
-    this->ReceiveMotorCommand();
-    if (this->dataPtr->arduPilotOnline)
+    if (this->hasFrameNumber)
     {
-      this->ApplyMotorForces((curTime -
-        this->dataPtr->lastControllerUpdateTime).Double());
-      this->SendState();
+      ++this->frameRestarts;
+      gzwarn << "[" << this->modelName << "] "
+             << "frame number went back from " << this->lastFrameNumber
+             << " to " << number << ", ArduPilot restarted.\n";
     }
+    this->hasFrameNumber = true;
   }
-
-  this->dataPtr->lastControllerUpdateTime = curTime;
+  else if (delta == 0)
+  {
+    ++this->framesDuplicated;
+    _frame.size = 0;
+    return 0;
+  }
+  else if (delta < 0)
+  {
+    ++this->framesReordered;
+    _frame.size = 0;
+    return 0;
+  }
+  else if (delta > 1)
+  {
+    // skipped frames drained in this receive arrived, they are not lost
+    const uint32_t skipped = static_cast<uint32_t>(delta - 1);
+    this->framesLost += skipped - std::min(skipped, dropped);
+  }
+  this->lastFrameNumber = number;
+  return _frame.size;
 }
 
 /////////////////////////////////////////////////
-void ArduPilotPlugin::ResetPIDs()
+void ArduPilotPluginPrivate::SendStateFrame(const StateFrame &_frame)
 {
-  // Reset velocity PID for controls
-  for (size_t i = 0; i < this->dataPtr->controls.size(); ++i)
+  if (this->protocolV2)
+  {
+    this->transport->Send(this->stateBuffer, this->EncodeStateV2(_frame));
+  }
+  else if (this->frameNumbers)
+  {
+    // {FrameHeader, fdmPacket} only, the v2 sensors stay behind
+    static_assert(offsetof(StateFrame, fdm) == sizeof(FrameHeader),
+        "frame header and state packet must be contiguous");
+    this->transport->Send(&_frame, sizeof(FrameHeader) + sizeof(fdmPacket));
+  }
+  else
   {
-    this->dataPtr->controls[i].cmd = 0;
-    // this->dataPtr->controls[i].pid.Reset();
+    this->transport->Send(&_frame.fdm, sizeof(_frame.fdm));
   }
 }
 
 /////////////////////////////////////////////////
-bool ArduPilotPlugin::InitArduPilotSockets(sdf::ElementPtr _sdf) const
+void ArduPilotPluginPrivate::ApplyServoFrame(const ServoFrame &_frame)
 {
-  this->dataPtr->fdm_addr =
-    _sdf->Get("fdm_addr", static_cast<std::string>("127.0.0.1")).first;
-  this->dataPtr->listen_addr =
-    _sdf->Get("listen_addr", static_cast<std::string>("127.0.0.1")).first;
-  this->dataPtr->fdm_port_in =
-    _sdf->Get("fdm_port_in", static_cast<uint32_t>(9002)).first;
-  this->dataPtr->fdm_port_out =
-    _sdf->Get("fdm_port_out", static_cast<uint32_t>(9003)).first;
-
-  if (!this->dataPtr->socket_in.Bind(this->dataPtr->listen_addr.c_str(),
-      this->dataPtr->fdm_port_in))
+  if (_frame.numbered)
   {
-    gzerr << "[" << this->dataPtr->modelName << "] "
-          << "failed to bind with " << this->dataPtr->listen_addr
-          << ":" << this->dataPtr->fdm_port_in << " aborting plugin.\n";
-    return false;
+    this->answerFrameNumber = _frame.header.frameNumber;
   }
+  this->lastCommandTime = this->model->GetWorld()->SimTime();
+  this->drainedPackets.Add(_frame.dropped);
 
-  if (!this->dataPtr->socket_out.Connect(this->dataPtr->fdm_addr.c_str(),
-      this->dataPtr->fdm_port_out))
+  const ssize_t expectedPktSize =
+    sizeof(_frame.pkt.motorSpeed[0]) * this->controls.size();
+  if (_frame.size < expectedPktSize)
   {
-    gzerr << "[" << this->dataPtr->modelName << "] "
-          << "failed to bind with " << this->dataPtr->fdm_addr
-          << ":" << this->dataPtr->fdm_port_out << " aborting plugin.\n";
-    return false;
+    gzerr << "[" << this->modelName << "] "
+          << "got less than model needs. Got: " << _frame.size
+          << "commands, expected size: " << expectedPktSize << "\n";
+  }
+  const ssize_t recvChannels = _frame.size / sizeof(_frame.pkt.motorSpeed[0]);
+  // for(unsigned int i = 0; i < recvChannels; ++i)
+  // {
+  //   gzdbg << "servo_command [" << i << "]: "
+  //         << _frame.pkt.motorSpeed[i] << "\n";
+  // }
+
+  if (!this->arduPilotOnline)
+  {
+    gzdbg << "[" << this->modelName << "] "
+          << "ArduPilot controller online detected.\n";
+    // made connection, set some flags
+    this->connectionTimeoutCount = 0;
+    this->arduPilotOnline = true;
   }
 
-  return true;
-}
-
-/////////////////////////////////////////////////
-void ArduPilotPlugin::ApplyMotorForces(const double _dt)
-{
-  // update velocity PID for controls and apply force to joint
-  for (size_t i = 0; i < this->dataPtr->controls.size(); ++i)
+  // compute command based on requested motorSpeed
+  for (unsigned i = 0; i < this->bank.Size(); ++i)
   {
-    if (this->dataPtr->controls[i].useForce)
+    if (i < MAX_MOTORS)
     {
-      if (this->dataPtr->controls[i].type == "VELOCITY")
-      {
-        const double velTarget = this->dataPtr->controls[i].cmd /
-          this->dataPtr->controls[i].rotorVelocitySlowdownSim;
-        const double vel = this->dataPtr->controls[i].joint->GetVelocity(0);
-        const double error = vel - velTarget;
-        const double force = this->dataPtr->controls[i].pid.Update(error, _dt);
-        this->dataPtr->controls[i].joint->SetForce(0, force);
-      }
-      else if (this->dataPtr->controls[i].type == "POSITION")
-      {
-        const double posTarget = this->dataPtr->controls[i].cmd;
-        const double pos = this->dataPtr->controls[i].joint->Position();
-        const double error = pos - posTarget;
-        const double force = this->dataPtr->controls[i].pid.Update(error, _dt);
-        this->dataPtr->controls[i].joint->SetForce(0, force);
-      }
-      else if (this->dataPtr->controls[i].type == "EFFORT")
+      if (this->bank.channel[i] < recvChannels)
       {
-        const double force = this->dataPtr->controls[i].cmd;
-        this->dataPtr->controls[i].joint->SetForce(0, force);
+        // bound incoming cmd between 0 and 1
+        const double cmd = ignition::math::clamp(
+          _frame.pkt.motorSpeed[this->bank.channel[i]],
+          -1.0f, 1.0f);
+        this->bank.cmd[i] =
+          this->bank.multiplier[i] * (this->bank.offset[i] + cmd);
+        // gzdbg << "apply input chan[" << this->bank.channel[i]
+        //       << "] to control chan[" << i
+        //       << "] with joint name ["
+        //       << this->controls[i].jointName
+        //       << "] raw cmd ["
+        //       << _frame.pkt.motorSpeed[this->bank.channel[i]]
+        //       << "] adjusted cmd [" << this->bank.cmd[i]
+        //       << "].\n";
       }
       else
       {
-        // do nothing
+        gzerr << "[" << this->modelName << "] "
+              << "control[" << i << "] channel ["
+              << this->bank.channel[i]
+              << "] is greater than incoming commands size["
+              << recvChannels
+              << "], control not applied.\n";
       }
     }
     else
     {
-      if (this->dataPtr->controls[i].type == "VELOCITY")
-      {
-        this->dataPtr->controls[i].joint->SetVelocity(0, this->dataPtr->controls[i].cmd);
-      }
-      else if (this->dataPtr->controls[i].type == "POSITION")
-      {
-        this->dataPtr->controls[i].joint->SetPosition(0, this->dataPtr->controls[i].cmd);
-      }
-      else if (this->dataPtr->controls[i].type == "EFFORT")
-      {
-        const double force = this->dataPtr->controls[i].cmd;
-        this->dataPtr->controls[i].joint->SetForce(0, force);
-      }
-      else
-      {
-        // do nothing
-      }
+      gzerr << "[" << this->modelName << "] "
+            << "too many motors, skipping [" << i
+            << " > " << MAX_MOTORS << "].\n";
     }
   }
 }
 
 /////////////////////////////////////////////////
-void ArduPilotPlugin::ReceiveMotorCommand()
+ignition::math::Vector3d ArduPilotPluginPrivate::Wind()
 {
-  // Added detection for whether ArduPilot is online or not.
-  // If ArduPilot is detected (receive of fdm packet from someone),
-  // then socket receive wait time is increased from 1ms to 1 sec
-  // to accomodate network jitter.
-  // If ArduPilot is not detected, receive call blocks for 1ms
-  // on each call.
-  // Once ArduPilot presence is detected, it takes this many
-  // missed receives before declaring the FCS offline.
-
-  ServoPacket pkt;
-  uint32_t waitMs;
-  if (this->dataPtr->arduPilotOnline)
+  physics::WorldPtr world = this->model->GetWorld();
+  if (!this->windLookedUp)
   {
-    // increase timeout for receive once we detect a packet from
-    // ArduPilot FCS.
-    waitMs = 1000;
+    this->wind = WindField::Find(world->Name());
+    this->windLookedUp = true;
   }
-  else
+  if (!this->wind)
   {
-    // Otherwise skip quickly and do not set control force.
-    waitMs = 1;
+    return ignition::math::Vector3d::Zero;
   }
-  ssize_t recvSize =
-    this->dataPtr->socket_in.Recv(&pkt, sizeof(ServoPacket), waitMs);
+  return this->wind->Velocity(this->model->WorldPose().Pos(),
+      world->SimTime().Double());
+}
 
-  // Drain the socket in the case we're backed up
-  int counter = 0;
-  ServoPacket last_pkt;
-  while (true)
-  {
-    // last_pkt = pkt;
-    const ssize_t recvSize_last =
-      this->dataPtr->socket_in.Recv(&last_pkt, sizeof(ServoPacket), 0ul);
-    if (recvSize_last == -1)
-    {
-      break;
-    }
-    counter++;
-    pkt = last_pkt;
-    recvSize = recvSize_last;
-  }
-  if (counter > 0)
+/////////////////////////////////////////////////
+void ArduPilotPluginPrivate::ReadImu(ignition::math::Vector3d &_accel,
+    ignition::math::Vector3d &_gyro)
+{
+  if (!this->imuLink)
   {
-    gzdbg << "[" << this->dataPtr->modelName << "] "
-          << "Drained n packets: " << counter << std::endl;
+    const ImuSample &sample = this->imu.Value();
+    _accel = sample.accel;
+    _gyro = sample.gyro;
+    return;
   }
 
-  if (recvSize == -1)
+  // Same kinematics as the Gazebo IMU sensor, but sampled on the physics
+  // thread together with the pose sent in the packet.
+  // zero sigma, the default, draws nothing from the shared generator
+  auto normal = [](const double _sigma)
   {
-    // didn't receive a packet
-    // gzdbg << "no packet\n";
-    gazebo::common::Time::NSleep(100);
-    if (this->dataPtr->arduPilotOnline)
+    if (_sigma <= 0.0)
     {
-      gzwarn << "[" << this->dataPtr->modelName << "] "
-             << "Broken ArduPilot connection, count ["
-             << this->dataPtr->connectionTimeoutCount
-             << "/" << this->dataPtr->connectionTimeoutMaxCount
-             << "]\n";
-      if (++this->dataPtr->connectionTimeoutCount >
-        this->dataPtr->connectionTimeoutMaxCount)
-      {
-        this->dataPtr->connectionTimeoutCount = 0;
-        this->dataPtr->arduPilotOnline = false;
-        gzwarn << "[" << this->dataPtr->modelName << "] "
-               << "Broken ArduPilot connection, resetting motor control.\n";
-        this->ResetPIDs();
-      }
+      return ignition::math::Vector3d::Zero;
     }
+    return ignition::math::Vector3d(
+        ignition::math::Rand::DblNormal(0.0, _sigma),
+        ignition::math::Rand::DblNormal(0.0, _sigma),
+        ignition::math::Rand::DblNormal(0.0, _sigma));
+  };
+
+  const gazebo::common::Time now = this->model->GetWorld()->SimTime();
+  const ignition::math::Vector3d vel = this->imuLink->WorldLinearVel();
+  const double dt = (now - this->imuLastTime).Double();
+  if (!this->imuHasLast || dt < 0.0)
+  {
+    // first sample or world reset, no velocity difference yet
+    this->imuWorldAccel = ignition::math::Vector3d::Zero;
   }
-  else
+  else if (dt > 0.0)
   {
-    const ssize_t expectedPktSize =
-    sizeof(pkt.motorSpeed[0]) * this->dataPtr->controls.size();
-    if (recvSize < expectedPktSize)
-    {
-      gzerr << "[" << this->dataPtr->modelName << "] "
-            << "got less than model needs. Got: " << recvSize
-            << "commands, expected size: " << expectedPktSize << "\n";
-    }
-    const ssize_t recvChannels = recvSize / sizeof(pkt.motorSpeed[0]);
-    // for(unsigned int i = 0; i < recvChannels; ++i)
-    // {
-    //   gzdbg << "servo_command [" << i << "]: " << pkt.motorSpeed[i] << "\n";
-    // }
-
-    if (!this->dataPtr->arduPilotOnline)
-    {
-      gzdbg << "[" << this->dataPtr->modelName << "] "
-            << "ArduPilot controller online detected.\n";
-      // made connection, set some flags
-      this->dataPtr->connectionTimeoutCount = 0;
-      this->dataPtr->arduPilotOnline = true;
-    }
-
-    // compute command based on requested motorSpeed
-    for (unsigned i = 0; i < this->dataPtr->controls.size(); ++i)
-    {
-      if (i < MAX_MOTORS)
-      {
-        if (this->dataPtr->controls[i].channel < recvChannels)
-        {
-          // bound incoming cmd between 0 and 1
-          const double cmd = ignition::math::clamp(
-            pkt.motorSpeed[this->dataPtr->controls[i].channel],
-            -1.0f, 1.0f);
-          this->dataPtr->controls[i].cmd =
-            this->dataPtr->controls[i].multiplier *
-            (this->dataPtr->controls[i].offset + cmd);
-          // gzdbg << "apply input chan[" << this->dataPtr->controls[i].channel
-          //       << "] to control chan[" << i
-          //       << "] with joint name ["
-          //       << this->dataPtr->controls[i].jointName
-          //       << "] raw cmd ["
-          //       << pkt.motorSpeed[this->dataPtr->controls[i].channel]
-          //       << "] adjusted cmd [" << this->dataPtr->controls[i].cmd
-          //       << "].\n";
-        }
-        else
-        {
-          gzerr << "[" << this->dataPtr->modelName << "] "
-                << "control[" << i << "] channel ["
-                << this->dataPtr->controls[i].channel
-                << "] is greater than incoming commands size["
-                << recvChannels
-                << "], control not applied.\n";
-        }
-      }
-      else
-      {
-        gzerr << "[" << this->dataPtr->modelName << "] "
-              << "too many motors, skipping [" << i
-              << " > " << MAX_MOTORS << "].\n";
-      }
-    }
+    this->imuWorldAccel = (vel - this->imuLastVel) / dt;
+  }
+  // a second read in the same step reuses the step's acceleration
+  if (!this->imuHasLast || !ignition::math::equal(dt, 0.0))
+  {
+    const double walk = std::sqrt(std::max(dt, 0.0));
+    this->gyroBias += normal(this->gyroBiasWalk * walk);
+    this->accelBias += normal(this->accelBiasWalk * walk);
+    this->imuLastVel = vel;
+    this->imuLastTime = now;
+    this->imuHasLast = true;
   }
+
+  // specific force, what an accelerometer at rest reads as -gravity
+  _accel = this->imuLink->WorldPose().Rot().RotateVectorReverse(
+      this->imuWorldAccel - this->model->GetWorld()->Gravity()) +
+    this->accelBias + normal(this->accelNoise);
+  _gyro = this->imuLink->RelativeAngularVel() + this->gyroBias +
+    normal(this->gyroNoise);
 }
 
 /////////////////////////////////////////////////
 void ArduPilotPlugin::SendState() const
 {
+  AP_TRACE_SCOPE("ArduPilotPlugin::SendState");
+
+  // the startup waiter owns the transport until ArduPilot connected
+  if (this->dataPtr->startupWaiting)
+  {
+    return;
+  }
   // send_fdm
-  fdmPacket pkt;
+  StateFrame frame;
+  frame.header.frameNumber = this->dataPtr->answerFrameNumber;
+  fdmPacket &pkt = frame.fdm;
 
   pkt.timestamp = this->dataPtr->model->GetWorld()->SimTime().Double();
 
@@ -1113,9 +3365,20 @@ void ArduPilotPlugin::SendState() const
   //   y right
   //   z down
 
+  // IMU readings are averaged over the sub-steps of the frame
+  const unsigned int imuSamples = this->dataPtr->imuSamples;
+  this->dataPtr->imuSamples = 0;
+
+  ignition::math::Vector3d imuAccel;
+  ignition::math::Vector3d imuGyro;
+  if (imuSamples == 0)
+  {
+    this->dataPtr->ReadImu(imuAccel, imuGyro);
+  }
+
   // get linear acceleration in body frame
-  const ignition::math::Vector3d linearAccel =
-    this->dataPtr->imuSensor->LinearAcceleration();
+  const ignition::math::Vector3d linearAccel = imuSamples > 0 ?
+    this->dataPtr->accelSum / imuSamples : imuAccel;
 
   // copy to pkt
   pkt.imuLinearAccelerationXYZ[0] = linearAccel.X();
@@ -1124,8 +3387,10 @@ void ArduPilotPlugin::SendState() const
   // gzerr << "lin accel [" << linearAccel << "]\n";
 
   // get angular velocity in body frame
-  const ignition::math::Vector3d angularVel =
-    this->dataPtr->imuSensor->AngularVelocity();
+  const ignition::math::Vector3d angularVel = imuSamples > 0 ?
+    this->dataPtr->gyroSum / imuSamples : imuGyro;
+  this->dataPtr->accelSum = ignition::math::Vector3d::Zero;
+  this->dataPtr->gyroSum = ignition::math::Vector3d::Zero;
 
   // copy to pkt
   pkt.imuAngularVelocityRPY[0] = angularVel.X();
@@ -1195,29 +3460,353 @@ void ArduPilotPlugin::SendState() const
   pkt.velocityXYZ[0] = velNEDFrame.X();
   pkt.velocityXYZ[1] = velNEDFrame.Y();
   pkt.velocityXYZ[2] = velNEDFrame.Z();
-/* NOT MERGED IN MASTER YET
-  if (!this->dataPtr->gpsSensor)
+  // optional sensors, only read when they have a new measurement
+  const uint32_t fields = this->dataPtr->protocolV2 ?
+    this->dataPtr->stateFieldMask : 0;
+  if ((fields & STATE_GPS) && this->dataPtr->gps)
+  {
+    const ignition::math::Vector3d &gps = this->dataPtr->gps.Value();
+    frame.gps[0] = gps.X();
+    frame.gps[1] = gps.Y();
+    frame.gps[2] = gps.Z();
+  }
+  if (fields & (STATE_RANGEFINDER | STATE_PROXIMITY))
+  {
+    this->dataPtr->rays.Cast();
+  }
+  if ((fields & STATE_RANGEFINDER) && this->dataPtr->rays.HasRangefinder())
+  {
+    frame.rangefinder = this->dataPtr->rays.Rangefinder();
+  }
+  else if ((fields & STATE_RANGEFINDER) && this->dataPtr->rangefinder)
+  {
+    frame.rangefinder = this->dataPtr->rangefinder.Value();
+  }
+  if (fields & STATE_PROXIMITY)
+  {
+    frame.proximityCount =
+      static_cast<uint32_t>(this->dataPtr->rays.ProximityCount());
+    this->dataPtr->rays.Proximity(frame.proximity);
+  }
+  if ((fields & STATE_BARO) && this->dataPtr->baro)
+  {
+    frame.baro = this->dataPtr->baro.Value();
+  }
+
+  frame.airspeed = (velGazeboWorldFrame - this->dataPtr->Wind()).Length();
+
+  if (this->dataPtr->useIOThread)
+  {
+    StateFrame *slot = this->dataPtr->fdmQueue.WriteSlot();
+    if (!slot)
+    {
+      gzwarn << "[" << this->dataPtr->modelName << "] "
+             << "state queue full, dropping state packet.\n";
+      return;
+    }
+    *slot = frame;
+    this->dataPtr->fdmQueue.Push();
+    #ifndef _WIN32
+    if (this->dataPtr->ioThreadWaiting.exchange(false))
     {
+      const char wake = 0;
+      if (write(this->dataPtr->ioWakePipe[1], &wake, 1) < 0)
+      {
+        // pipe already holds a pending wake-up
+      }
+    }
+    #endif
+    return;
+  }
+
+  this->dataPtr->SendStateFrame(frame);
+  this->dataPtr->lastSendTime = std::chrono::steady_clock::now();
+  this->dataPtr->awaitingReply = true;
+}
+
+/////////////////////////////////////////////////
+void ArduPilotPluginPrivate::RunIOThread()
+{
+  using clock = std::chrono::steady_clock;
+  clock::time_point lastRecvTime = clock::now();
+
+  if (this->ioThreadCpu >= 0 && !PinCurrentThread(this->ioThreadCpu))
+  {
+    gzwarn << "[" << this->modelName << "] "
+           << "failed to pin network I/O thread to CPU "
+           << this->ioThreadCpu << ".\n";
+  }
 
+  while (!this->ioThreadStop)
+  {
+    // Flush state packets queued by the physics thread.
+    const StateFrame *state;
+    while ((state = this->fdmQueue.Front()) != nullptr)
+    {
+      this->SendStateFrame(*state);
+      this->fdmQueue.Pop();
     }
-    else {
-        pkt.longitude = this->dataPtr->gpsSensor->Longitude().Degree();
-        pkt.latitude = this->dataPtr->gpsSensor->Latitude().Degree();
-        pkt.altitude = this->dataPtr->gpsSensor->Altitude();
+
+    // Announce that we are about to block, then re-check the queue so a
+    // state packet pushed in between is not left waiting.
+    this->ioThreadWaiting = true;
+    if (!this->fdmQueue.Empty())
+    {
+      this->ioThreadWaiting = false;
+      continue;
     }
 
-    // TODO : make generic enough to accept sonar/gpuray etc. too
-    if (!this->dataPtr->rangefinderSensor)
+    const bool online = this->ioArduPilotOnline;
+    const uint32_t waitMs = online ? 1000 : 100;
+    ServoFrame &frame = this->servoMailbox.WriteSlot();
+    this->RecvServoFrame(frame, waitMs, this->ioWakePipe[0]);
+    this->ioThreadWaiting = false;
+
+    #ifndef _WIN32
+    // Consume any pending wake-ups.
+    char wake[16];
+    while (read(this->ioWakePipe[0], wake, sizeof(wake)) > 0)
     {
+    }
+    #endif
 
-    } else {
-        // Rangefinder value can not be send as Inf to ardupilot
-        const double range = this->dataPtr->rangefinderSensor->Range(0);
-        pkt.rangefinder = std::isinf(range) ? 0.0 : range;
+    if (frame.size > 0)
+    {
+      lastRecvTime = clock::now();
+      this->ioArduPilotOnline = true;
+      this->servoMailbox.Publish();
+      this->ReleaseWorld();
+    }
+    else if (online && clock::now() - lastRecvTime > std::chrono::seconds(
+          this->connectionTimeoutMaxCount + 1))
+    {
+      this->ioArduPilotOnline = false;
     }
+  }
+}
 
-  // airspeed :     wind = Vector3(environment.wind.x, environment.wind.y, environment.wind.z)
-   // pkt.airspeed = (pkt.velocity - wind).length()
-*/
-  this->dataPtr->socket_out.Send(&pkt, sizeof(pkt));
+/////////////////////////////////////////////////
+void ArduPilotPluginPrivate::ReleaseWorld()
+{
+  if (this->worldHeld.exchange(false))
+  {
+    const bool resumed = this->worldHold->Release(this->model->GetWorld());
+    gzmsg << "[" << this->modelName << "] "
+          << "ArduPilot connected, "
+          << (resumed ? "resuming world.\n" :
+              "world held for the other vehicles.\n");
+  }
+}
+
+/////////////////////////////////////////////////
+void ArduPilotPluginPrivate::RunStartupWaiter()
+{
+  // The physics thread leaves the transport alone while startupWaiting
+  // is set, even if the world is unpaused from the GUI meanwhile: it
+  // neither receives nor sends. Wake up periodically only to notice the
+  // plugin unloading.
+  while (!this->ioThreadStop)
+  {
+    ServoFrame &frame = this->servoMailbox.WriteSlot();
+    if (this->RecvServoFrame(frame, 100) > 0)
+    {
+      this->servoMailbox.Publish();
+      break;
+    }
+  }
+  this->startupWaiting = false;
+  if (!this->ioThreadStop)
+  {
+    this->ReleaseWorld();
+  }
+}
+
+/////////////////////////////////////////////////
+size_t ArduPilotPluginPrivate::EncodeStateV2(const StateFrame &_frame)
+{
+  uint8_t *out = this->stateBuffer + sizeof(StateHeaderV2);
+
+  // values are copied straight into the send buffer, which carries no
+  // alignment guarantee past the header
+  auto putDouble = [&out](const double *_v, const size_t _n)
+  {
+    memcpy(out, _v, _n * sizeof(double));
+    out += _n * sizeof(double);
+  };
+  auto put = [&out, &putDouble, this](const double *_v, const size_t _n)
+  {
+    if (!this->stateFloat32)
+    {
+      putDouble(_v, _n);
+      return;
+    }
+    for (size_t i = 0; i < _n; ++i)
+    {
+      const float f = static_cast<float>(_v[i]);
+      memcpy(out, &f, sizeof(f));
+      out += sizeof(f);
+    }
+  };
+
+  const fdmPacket &fdm = _frame.fdm;
+  const uint32_t mask = this->stateFieldMask;
+  putDouble(&fdm.timestamp, 1);
+  if (mask & STATE_IMU)
+  {
+    put(fdm.imuAngularVelocityRPY, 3);
+    put(fdm.imuLinearAccelerationXYZ, 3);
+  }
+  if (mask & STATE_ATTITUDE)
+  {
+    put(fdm.imuOrientationQuat, 4);
+  }
+  if (mask & STATE_VELOCITY)
+  {
+    put(fdm.velocityXYZ, 3);
+  }
+  if (mask & STATE_POSITION)
+  {
+    put(fdm.positionXYZ, 3);
+  }
+  if (mask & STATE_GPS)
+  {
+    putDouble(_frame.gps, 3);
+  }
+  if (mask & STATE_AIRSPEED)
+  {
+    put(&_frame.airspeed, 1);
+  }
+  if (mask & STATE_BATTERY)
+  {
+    put(_frame.battery, 2);
+  }
+  if (mask & STATE_RANGEFINDER)
+  {
+    put(&_frame.rangefinder, 1);
+  }
+  if (mask & STATE_BARO)
+  {
+    put(&_frame.baro, 1);
+  }
+  if (mask & STATE_PROXIMITY)
+  {
+    const double count = _frame.proximityCount;
+    put(&count, 1);
+    put(_frame.proximity, _frame.proximityCount);
+  }
+
+  StateHeaderV2 header;
+  header.flags = this->stateFloat32 ? STATE_FLAG_FLOAT32 : 0;
+  header.frameNumber = _frame.header.frameNumber;
+  header.fieldMask = mask;
+  header.channelCount = this->servoChannelCount;
+  header.payloadSize = static_cast<uint16_t>(
+      out - this->stateBuffer - sizeof(StateHeaderV2));
+  memcpy(this->stateBuffer, &header, sizeof(header));
+  return static_cast<size_t>(out - this->stateBuffer);
+}
+
+/////////////////////////////////////////////////
+void ArduPilotPluginPrivate::ConfigureStateFields(sdf::ElementPtr _sdf)
+{
+  uint32_t available = STATE_IMU | STATE_ATTITUDE | STATE_VELOCITY |
+    STATE_POSITION | STATE_AIRSPEED;
+  if (this->gps)
+  {
+    available |= STATE_GPS;
+  }
+  if (this->rangefinder || this->rays.HasRangefinder())
+  {
+    available |= STATE_RANGEFINDER;
+  }
+  if (this->rays.ProximityCount() > 0)
+  {
+    available |= STATE_PROXIMITY;
+  }
+  if (this->baro)
+  {
+    available |= STATE_BARO;
+  }
+
+  if (!_sdf->HasElement("stateFields"))
+  {
+    this->stateFieldMask = available & ~STATE_AIRSPEED;
+    return;
+  }
+
+  static const std::map<std::string, uint32_t> kFieldNames = {
+    {"imu", STATE_IMU}, {"attitude", STATE_ATTITUDE},
+    {"velocity", STATE_VELOCITY}, {"position", STATE_POSITION},
+    {"gps", STATE_GPS}, {"airspeed", STATE_AIRSPEED},
+    {"battery", STATE_BATTERY}, {"rangefinder", STATE_RANGEFINDER},
+    {"baro", STATE_BARO}, {"proximity", STATE_PROXIMITY}};
+
+  std::istringstream fields(_sdf->Get<std::string>("stateFields"));
+  std::string name;
+  this->stateFieldMask = 0;
+  while (fields >> name)
+  {
+    const auto field = kFieldNames.find(name);
+    if (field == kFieldNames.end())
+    {
+      gzwarn << "[" << this->modelName << "] "
+             << "state field [" << name << "] not recognized.\n";
+    }
+    else if (!(available & field->second))
+    {
+      gzwarn << "[" << this->modelName << "] "
+             << "no sensor for state field [" << name << "], skipped.\n";
+    }
+    else
+    {
+      this->stateFieldMask |= field->second;
+    }
+  }
+}
+
+/////////////////////////////////////////////////
+bool ArduPilotPluginPrivate::ReceivesDirectly() const
+{
+  return !this->useIOThread &&
+    !(this->startupMode == StartupMode::PAUSE && !this->arduPilotOnline);
+}
+
+/////////////////////////////////////////////////
+void ArduPilotPluginPrivate::PlanReceive()
+{
+  this->keepLastCommand = false;
+  this->receivePlanned = true;
+  if (this->arduPilotOnline &&
+      this->syncMode == SyncMode::ASYNC &&
+      this->model->GetWorld()->SimTime() -
+        this->lastCommandTime <= this->maxStaleness)
+  {
+    // the current command is recent enough, only pick up a newer one
+    this->recvWaitMs = 0;
+    this->keepLastCommand = true;
+  }
+  else if (this->arduPilotOnline)
+  {
+    // wait a few deviations past the usual reply interval
+    this->recvWaitMs = this->replyTimeout.TimeoutMs();
+    if (this->syncMode == SyncMode::ASYNC)
+    {
+      ++this->stalenessWaits;
+    }
+  }
+  else if (this->startupMode == StartupMode::FREE_RUN)
+  {
+    // Do not hold physics until ArduPilot shows up.
+    this->recvWaitMs = 0;
+  }
+  else if (this->startupMode == StartupMode::BLOCK)
+  {
+    // Hold every step until ArduPilot shows up.
+    this->recvWaitMs = this->replyTimeout.MaxMs();
+  }
+  else
+  {
+    // Otherwise skip quickly and do not set control force.
+    this->recvWaitMs = 1;
+  }
 }
@@ -0,0 +1,377 @@
+/*
+ * Copyright (C) 2026 ardupilot_sitl_gazebo contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <thread>
+
+#ifndef _WIN32
+  #include <fcntl.h>
+  #include <signal.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+#ifdef __linux__
+  #include <linux/futex.h>
+  #include <sys/syscall.h>
+  #include <time.h>
+#endif
+
+#include "include/ArduPilotShm.hh"
+
+using namespace gazebo;
+
+/// \brief Segment identifier, "APGZ"
+static const uint32_t kShmMagic = 0x5a475041;
+
+/// \brief Layout version, bump on any change to ArduPilotShmSegment
+static const uint32_t kShmVersion = 2;
+
+/// \brief One single-writer packet slot
+struct ArduPilotShmSlot
+{
+  /// \brief Sequence counter, odd while the writer is copying.
+  /// Also used as futex word.
+  std::atomic<uint32_t> seq;
+
+  /// \brief Readers blocked on seq, lets the writer skip the wake syscall
+  std::atomic<uint32_t> waiters;
+
+  /// \brief Size of the packet in data
+  uint32_t size;
+
+  /// \brief Packet data
+  uint8_t data[ArduPilotShm::kSlotCapacity];
+};
+
+/// \brief Shared memory segment layout
+struct gazebo::ArduPilotShmSegment
+{
+  /// \brief kShmMagic once the creator finished initialising
+  std::atomic<uint32_t> magic;
+
+  /// \brief kShmVersion
+  uint32_t version;
+
+  /// \brief Process id of the creator
+  int32_t ownerPid;
+
+  /// \brief [0] servo packets to Gazebo, [1] state packets to ArduPilot
+  ArduPilotShmSlot slots[2];
+};
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+    "futex words must be plain 32 bit integers");
+
+/////////////////////////////////////////////////
+/// \brief Block while *_word == _expected, for at most _timeoutMs.
+static void WaitOnWord(std::atomic<uint32_t> *_word, const uint32_t _expected,
+    const uint32_t _timeoutMs)
+{
+#ifdef __linux__
+  struct timespec ts;
+  ts.tv_sec = _timeoutMs / 1000;
+  ts.tv_nsec = (_timeoutMs % 1000) * 1000000L;
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(_word), FUTEX_WAIT,
+      _expected, &ts, nullptr, 0);
+#else
+  // No process-shared futex, poll the word instead.
+  const auto deadline = std::chrono::steady_clock::now() +
+    std::chrono::milliseconds(_timeoutMs);
+  while (_word->load(std::memory_order_acquire) == _expected &&
+      std::chrono::steady_clock::now() < deadline)
+  {
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+  }
+#endif
+}
+
+/////////////////////////////////////////////////
+/// \brief Wake every thread blocked on _word.
+static void WakeWord(std::atomic<uint32_t> *_word)
+{
+#ifdef __linux__
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(_word), FUTEX_WAKE,
+      INT32_MAX, nullptr, nullptr, 0);
+#else
+  (void)_word;
+#endif
+}
+
+/////////////////////////////////////////////////
+/// \brief Check whether a segment is held by a running creator.
+/// \param[in] _name POSIX shared memory name.
+/// \return True if the segment exists and its creator is still alive or
+/// still setting it up.
+static bool HasLiveOwner(const std::string &_name)
+{
+#ifdef _WIN32
+  (void)_name;
+  return false;
+#else
+  const int fd = shm_open(_name.c_str(), O_RDONLY, 0);
+  if (fd < 0)
+  {
+    return false;
+  }
+  const size_t headerSize = offsetof(ArduPilotShmSegment, slots);
+  struct stat info;
+  void *addr = MAP_FAILED;
+  if (fstat(fd, &info) == 0 &&
+      info.st_size >= static_cast<off_t>(headerSize))
+  {
+    addr = mmap(nullptr, headerSize, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  ::close(fd);
+  if (addr == MAP_FAILED)
+  {
+    // not sized yet, the creator is between shm_open and ftruncate
+    return true;
+  }
+
+  const ArduPilotShmSegment *segment =
+    static_cast<const ArduPilotShmSegment *>(addr);
+  bool alive = true;
+  if (segment->magic.load(std::memory_order_acquire) == kShmMagic)
+  {
+    // a segment of another layout version is left over from an older
+    // build
+    alive = segment->version == kShmVersion && segment->ownerPid > 0 &&
+      (kill(segment->ownerPid, 0) == 0 || errno == EPERM);
+  }
+  munmap(addr, headerSize);
+  return alive;
+#endif
+}
+
+/////////////////////////////////////////////////
+ArduPilotShm::ArduPilotShm()
+{
+}
+
+/////////////////////////////////////////////////
+ArduPilotShm::~ArduPilotShm()
+{
+#ifndef _WIN32
+  if (this->segment)
+  {
+    munmap(this->segment, sizeof(ArduPilotShmSegment));
+    this->segment = nullptr;
+  }
+  if (!this->ownedName.empty())
+  {
+    shm_unlink(this->ownedName.c_str());
+  }
+#endif
+}
+
+/////////////////////////////////////////////////
+bool ArduPilotShm::Create(const std::string &_name)
+{
+  this->txSlot = 1;
+  this->rxSlot = 0;
+  return this->Map(_name, true);
+}
+
+/////////////////////////////////////////////////
+bool ArduPilotShm::Open(const std::string &_name)
+{
+  this->txSlot = 0;
+  this->rxSlot = 1;
+  return this->Map(_name, false);
+}
+
+/////////////////////////////////////////////////
+bool ArduPilotShm::IsOpen() const
+{
+  return this->segment != nullptr;
+}
+
+/////////////////////////////////////////////////
+void ArduPilotShm::SetSpinBudget(const uint32_t _spinUs)
+{
+  this->spinUs = _spinUs;
+}
+
+/////////////////////////////////////////////////
+ArduPilotWaitStats ArduPilotShm::WaitStats() const
+{
+  return this->stats;
+}
+
+/////////////////////////////////////////////////
+bool ArduPilotShm::Map(const std::string &_name, const bool _create)
+{
+#ifdef _WIN32
+  (void)_name;
+  (void)_create;
+  return false;
+#else
+  const int flags = _create ? (O_RDWR | O_CREAT | O_EXCL) : O_RDWR;
+  int fd = shm_open(_name.c_str(), flags, 0600);
+  if (fd < 0 && _create && errno == EEXIST && !HasLiveOwner(_name))
+  {
+    // remove a segment left behind by a crashed run, a running
+    // simulator's segment is never taken over
+    shm_unlink(_name.c_str());
+    fd = shm_open(_name.c_str(), flags, 0600);
+  }
+  if (fd < 0)
+  {
+    return false;
+  }
+
+  if (_create &&
+      ftruncate(fd, sizeof(ArduPilotShmSegment)) != 0)
+  {
+    ::close(fd);
+    shm_unlink(_name.c_str());
+    return false;
+  }
+
+  void *addr = mmap(nullptr, sizeof(ArduPilotShmSegment),
+      PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (addr == MAP_FAILED)
+  {
+    if (_create)
+    {
+      shm_unlink(_name.c_str());
+    }
+    return false;
+  }
+
+  this->segment = static_cast<ArduPilotShmSegment *>(addr);
+  if (_create)
+  {
+    // ftruncate zero fills, only the header needs setting up
+    this->segment->version = kShmVersion;
+    this->segment->ownerPid = static_cast<int32_t>(getpid());
+    this->segment->magic.store(kShmMagic, std::memory_order_release);
+    this->ownedName = _name;
+  }
+  else if (this->segment->magic.load(std::memory_order_acquire) !=
+      kShmMagic || this->segment->version != kShmVersion)
+  {
+    munmap(this->segment, sizeof(ArduPilotShmSegment));
+    this->segment = nullptr;
+    return false;
+  }
+
+  // Only packets published from now on are new to us.
+  this->rxSeq = this->segment->slots[this->rxSlot].seq.load(
+      std::memory_order_acquire) & ~1u;
+  return true;
+#endif
+}
+
+/////////////////////////////////////////////////
+ssize_t ArduPilotShm::Send(const void *_buf, const size_t _size)
+{
+  if (!this->segment || _size > kSlotCapacity)
+  {
+    return -1;
+  }
+
+  ArduPilotShmSlot &slot = this->segment->slots[this->txSlot];
+  const uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+
+  // odd sequence: write in progress
+  slot.seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(slot.data, _buf, _size);
+  slot.size = static_cast<uint32_t>(_size);
+  slot.seq.store(seq + 2, std::memory_order_seq_cst);
+
+  if (slot.waiters.load(std::memory_order_seq_cst) > 0)
+  {
+    WakeWord(&slot.seq);
+  }
+  return static_cast<ssize_t>(_size);
+}
+
+/////////////////////////////////////////////////
+ssize_t ArduPilotShm::RecvLatest(void *_buf, const size_t _size,
+    uint32_t _timeoutMs, uint32_t &_dropped)
+{
+  _dropped = 0;
+  if (!this->segment)
+  {
+    return -1;
+  }
+
+  ArduPilotShmSlot &slot = this->segment->slots[this->rxSlot];
+  const auto start = std::chrono::steady_clock::now();
+  const auto deadline = start + std::chrono::milliseconds(_timeoutMs);
+  const auto spinEnd = start + std::chrono::microseconds(this->spinUs);
+  bool blocked = false;
+
+  while (true)
+  {
+    const uint32_t seq = slot.seq.load(std::memory_order_acquire);
+    if (seq != this->rxSeq && !(seq & 1u))
+    {
+      const size_t size = slot.size;
+      memcpy(_buf, slot.data, std::min(size, _size));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.seq.load(std::memory_order_relaxed) != seq)
+      {
+        // overwritten while copying, retry with the newer packet
+        continue;
+      }
+      _dropped = (seq - this->rxSeq) / 2 - 1;
+      this->rxSeq = seq;
+      if (blocked)
+      {
+        ++this->stats.blockWakeups;
+      }
+      else
+      {
+        ++this->stats.spinWakeups;
+      }
+      return static_cast<ssize_t>(std::min(size, _size));
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    if (now >= deadline)
+    {
+      if (_timeoutMs > 0)
+      {
+        // a zero timeout is a probe, not an expired wait
+        ++this->stats.timeouts;
+      }
+      return -1;
+    }
+    if (now < spinEnd)
+    {
+      continue;
+    }
+    const uint32_t remainingMs = static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+          deadline - now).count()) + 1;
+
+    blocked = true;
+    slot.waiters.fetch_add(1, std::memory_order_seq_cst);
+    WaitOnWord(&slot.seq, seq, remainingMs);
+    slot.waiters.fetch_sub(1, std::memory_order_seq_cst);
+  }
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2026 ardupilot_sitl_gazebo contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include "include/ArduPilotShm.hh"
+#include "include/ArduPilotShmPeer.hh"
+
+/// \brief Peer handle, wraps the controller end of the segment
+struct ap_shm_peer
+{
+  /// \brief Shared memory transport
+  gazebo::ArduPilotShm shm;
+};
+
+/////////////////////////////////////////////////
+ap_shm_peer *ap_shm_peer_open(const char *_name)
+{
+  ap_shm_peer *peer = new ap_shm_peer;
+  if (!_name || !peer->shm.Open(_name))
+  {
+    delete peer;
+    return nullptr;
+  }
+  return peer;
+}
+
+/////////////////////////////////////////////////
+void ap_shm_peer_close(ap_shm_peer *_peer)
+{
+  delete _peer;
+}
+
+/////////////////////////////////////////////////
+int ap_shm_peer_send_servo(ap_shm_peer *_peer, const void *_buf,
+    size_t _size)
+{
+  if (!_peer)
+  {
+    return -1;
+  }
+  return static_cast<int>(_peer->shm.Send(_buf, _size));
+}
+
+/////////////////////////////////////////////////
+int ap_shm_peer_recv_state(ap_shm_peer *_peer, void *_buf, size_t _size,
+    uint32_t _timeoutMs)
+{
+  if (!_peer)
+  {
+    return -1;
+  }
+  uint32_t dropped = 0;
+  return static_cast<int>(
+      _peer->shm.RecvLatest(_buf, _size, _timeoutMs, dropped));
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2026 ardupilot_sitl_gazebo contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+// Stub flight stack for the in-process transport. It commands the same
+// value on every channel, so a model can be checked against the plugin
+// without a real SITL build. <sitl_args> may hold
+// "channels=<n> throttle=<value> steps=<n>", the stub stops commanding
+// after steps state packets when it is set.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "include/ArduPilotSitlLibrary.hh"
+
+/// \brief Stub instance
+struct ap_sitl
+{
+  /// \brief Number of channels commanded
+  int channels = 4;
+
+  /// \brief Value commanded on every channel
+  float throttle = 0.0f;
+
+  /// \brief Number of state packets received
+  uint64_t steps = 0;
+
+  /// \brief State packets answered before failing, 0 for no limit
+  uint64_t maxSteps = 0;
+};
+
+/////////////////////////////////////////////////
+uint32_t ap_sitl_abi_version(void)
+{
+  return AP_SITL_ABI_VERSION;
+}
+
+/////////////////////////////////////////////////
+ap_sitl *ap_sitl_create(const char *_args)
+{
+  ap_sitl *sitl = new ap_sitl;
+  if (_args)
+  {
+    const char *channels = strstr(_args, "channels=");
+    if (channels)
+    {
+      sscanf(channels, "channels=%d", &sitl->channels);
+    }
+    const char *throttle = strstr(_args, "throttle=");
+    if (throttle)
+    {
+      sscanf(throttle, "throttle=%f", &sitl->throttle);
+    }
+    const char *steps = strstr(_args, "steps=");
+    unsigned long maxSteps = 0;
+    if (steps && sscanf(steps, "steps=%lu", &maxSteps) == 1)
+    {
+      sitl->maxSteps = maxSteps;
+    }
+  }
+  if (sitl->channels < 1)
+  {
+    sitl->channels = 1;
+  }
+  return sitl;
+}
+
+/////////////////////////////////////////////////
+int ap_sitl_step(ap_sitl *_sitl, const void *_state, size_t /*_stateSize*/,
+    void *_servo, size_t _servoSize)
+{
+  if (!_sitl)
+  {
+    return -1;
+  }
+  if (_sitl->maxSteps > 0 && _sitl->steps >= _sitl->maxSteps)
+  {
+    // the flight stack stopped
+    return -1;
+  }
+  if (_state)
+  {
+    ++_sitl->steps;
+  }
+
+  float *servo = static_cast<float *>(_servo);
+  const size_t count = std::min(static_cast<size_t>(_sitl->channels),
+      _servoSize / sizeof(float));
+  for (size_t i = 0; i < count; ++i)
+  {
+    servo[i] = _sitl->throttle;
+  }
+  return static_cast<int>(count * sizeof(float));
+}
+
+/////////////////////////////////////////////////
+void ap_sitl_destroy(ap_sitl *_sitl)
+{
+  delete _sitl;
+}
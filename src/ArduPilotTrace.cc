@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2026 ardupilot_sitl_gazebo contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+  #include <unistd.h>
+#endif
+
+#include "include/ArduPilotTrace.hh"
+
+using namespace gazebo;
+
+/// \brief One recorded span
+struct TraceEvent
+{
+  /// \brief Name identifier
+  uint32_t id;
+
+  /// \brief Start time in ns
+  uint64_t start;
+
+  /// \brief Duration in ns
+  uint64_t duration;
+};
+
+/// \brief Single-producer ring of one thread's spans
+struct TraceRing
+{
+  /// \brief Spans recorded so far, the next slot is head % kCapacity
+  std::atomic<uint64_t> head{0};
+
+  /// \brief Trace thread id
+  uint32_t tid = 0;
+
+  /// \brief Span slots
+  TraceEvent events[TraceRecorder::kCapacity];
+};
+
+/// \brief Names and rings of the process, writes the trace on exit
+struct TraceRegistry
+{
+  /// \brief Destructor, writes the trace file.
+  ~TraceRegistry()
+  {
+    const char *path = std::getenv("ARDUPILOT_GAZEBO_TRACE");
+    TraceRecorder::Write(path ? path : "ardupilot_gazebo_trace.json");
+  }
+
+  /// \brief Protects names and rings
+  std::mutex mutex;
+
+  /// \brief Interned span names
+  std::vector<std::string> names;
+
+  /// \brief Rings of every thread that recorded, kept after it exits
+  std::vector<std::unique_ptr<TraceRing>> rings;
+};
+
+/// \brief The registry, destroyed after every span was recorded
+static TraceRegistry registry;
+
+/// \brief Ring of the calling thread
+static thread_local TraceRing *threadRing = nullptr;
+
+/////////////////////////////////////////////////
+uint32_t TraceRecorder::Intern(const char *_name)
+{
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.names.push_back(_name);
+  return static_cast<uint32_t>(registry.names.size() - 1);
+}
+
+/////////////////////////////////////////////////
+uint64_t TraceRecorder::Now()
+{
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/////////////////////////////////////////////////
+void TraceRecorder::Record(const uint32_t _id, const uint64_t _startNs,
+    const uint64_t _endNs)
+{
+  TraceRing *ring = threadRing;
+  if (!ring)
+  {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.rings.emplace_back(new TraceRing);
+    ring = registry.rings.back().get();
+    ring->tid = static_cast<uint32_t>(registry.rings.size());
+    threadRing = ring;
+  }
+
+  const uint64_t head = ring->head.load(std::memory_order_relaxed);
+  TraceEvent &event = ring->events[head % kCapacity];
+  event.id = _id;
+  event.start = _startNs;
+  event.duration = _endNs - _startNs;
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+/////////////////////////////////////////////////
+bool TraceRecorder::Write(const std::string &_path)
+{
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  if (registry.rings.empty())
+  {
+    return true;
+  }
+
+  FILE *file = fopen(_path.c_str(), "w");
+  if (!file)
+  {
+    fprintf(stderr, "[ArduPilotTrace] failed to write [%s].\n",
+        _path.c_str());
+    return false;
+  }
+
+#ifndef _WIN32
+  const int pid = static_cast<int>(getpid());
+#else
+  const int pid = 0;
+#endif
+
+  fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+  const char *separator = "\n";
+  for (const auto &ring : registry.rings)
+  {
+    // spans of a thread still running may be overwritten meanwhile, only
+    // the newest ones are worth keeping anyway
+    const uint64_t head = ring->head.load(std::memory_order_acquire);
+    const uint64_t first = head > kCapacity ? head - kCapacity : 0;
+    for (uint64_t i = first; i < head; ++i)
+    {
+      const TraceEvent &event = ring->events[i % kCapacity];
+      const char *name = event.id < registry.names.size() ?
+        registry.names[event.id].c_str() : "?";
+      fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,"
+          "\"dur\":%.3f,\"pid\":%d,\"tid\":%u}", separator, name,
+          event.start * 1e-3, event.duration * 1e-3, pid, ring->tid);
+      separator = ",\n";
+    }
+  }
+  fprintf(file, "\n]}\n");
+  if (fclose(file) != 0)
+  {
+    fprintf(stderr, "[ArduPilotTrace] failed to write [%s].\n",
+        _path.c_str());
+    return false;
+  }
+  fprintf(stderr, "[ArduPilotTrace] wrote [%s].\n", _path.c_str());
+  return true;
+}
@@ -0,0 +1,1438 @@
+/*
+ * Copyright (C) 2026 ardupilot_sitl_gazebo contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <fcntl.h>
+#ifdef _WIN32
+  #include <Winsock2.h>
+  #include <Ws2def.h>
+  #include <Ws2ipdef.h>
+  #include <Ws2tcpip.h>
+  using raw_type = char;
+#else
+  #include <sys/socket.h>
+  #include <sys/un.h>
+  #include <netinet/in.h>
+  #include <netinet/tcp.h>
+  #include <arpa/inet.h>
+  #include <dlfcn.h>
+  #include <poll.h>
+  #include <unistd.h>
+  using raw_type = void;
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "include/ArduPilotShm.hh"
+#include "include/ArduPilotSitlLibrary.hh"
+#include "include/ArduPilotTransport.hh"
+
+using namespace gazebo;
+
+namespace
+{
+  /// \brief One socket of a link, either the receiving or the sending end.
+  class ArduPilotSocket
+  {
+    /// \brief Constructor
+    /// \param[in] _family AF_INET or AF_UNIX.
+    /// \param[in] _type SOCK_DGRAM or SOCK_SEQPACKET.
+    public: ArduPilotSocket(const int _family, const int _type)
+      : family(_family), type(_type)
+    {
+      this->fd = this->NewSocket();
+    }
+
+    /// \brief destructor
+    public: ~ArduPilotSocket()
+    {
+      this->Close(this->connFd);
+      this->Close(this->fd);
+      #ifndef _WIN32
+      if (!this->boundPath.empty())
+      {
+        unlink(this->boundPath.c_str());
+      }
+      #endif
+    }
+
+    /// \brief Bind to an adress and port
+    /// \param[in] _address Address to bind to.
+    /// \param[in] _port Port to bind to.
+    /// \return True on success.
+    public: bool Bind(const std::string &_address, const uint16_t _port)
+    {
+      struct sockaddr_storage sockaddr;
+      socklen_t len;
+      if (this->fd == -1 ||
+          !this->MakeSockAddr(_address, _port, sockaddr, len))
+      {
+        return false;
+      }
+
+      // No SO_REUSEADDR: on Linux it lets a second UDP socket bind the
+      // same port and split the servo stream, hiding port collisions.
+
+      #ifndef _WIN32
+      if (this->family == AF_UNIX && _address[0] != '@')
+      {
+        // remove a socket file left behind by a previous run
+        unlink(_address.c_str());
+      }
+      #endif
+
+      if (bind(this->fd, (struct sockaddr *)&sockaddr, len) != 0)
+      {
+        shutdown(this->fd, 0);
+        this->Close(this->fd);
+        return false;
+      }
+
+      #ifndef _WIN32
+      if (this->family == AF_UNIX && _address[0] != '@')
+      {
+        this->boundPath = _address;
+      }
+      #endif
+
+      if (this->type == SOCK_SEQPACKET && listen(this->fd, 1) != 0)
+      {
+        this->Close(this->fd);
+        return false;
+      }
+
+      this->SetNonBlocking(this->fd);
+      return true;
+    }
+
+    /// \brief Connect to an adress and port
+    /// Unix sockets only exist once the peer created them, so for those a
+    /// failed connect is retried on every Send().
+    /// \param[in] _address Address to connect to.
+    /// \param[in] _port Port to connect to.
+    /// \return True on success.
+    public: bool Connect(const std::string &_address, const uint16_t _port)
+    {
+      if (this->fd == -1 || !this->MakeSockAddr(
+            _address, _port, this->remote, this->remoteLen))
+      {
+        return false;
+      }
+      this->hasRemote = true;
+
+      if (this->TryConnect())
+      {
+        return true;
+      }
+      return this->family == AF_UNIX;
+    }
+
+    /// \brief Send data to the connected address
+    /// \param[in] _buf Data.
+    /// \param[in] _size Data size.
+    /// \return Bytes sent, or -1.
+    public: ssize_t Send(const void *_buf, const size_t _size)
+    {
+      if (!this->connected && !this->TryConnect())
+      {
+        return -1;
+      }
+      #ifdef _WIN32
+      return send(this->fd, reinterpret_cast<const char *>(_buf), _size, 0);
+      #else
+      const ssize_t n = send(this->fd, _buf, _size, MSG_NOSIGNAL);
+      if (n < 0 && this->family == AF_UNIX &&
+          (errno == ECONNREFUSED || errno == ENOTCONN || errno == EPIPE))
+      {
+        // peer went away, reconnect once it comes back
+        this->Reopen();
+      }
+      return n;
+      #endif
+    }
+
+    /// \brief Wait for data, then drain every queued datagram and keep
+    /// only the newest one.
+    /// On Linux the queue is drained with recvmmsg into a preallocated
+    /// ring, so a backlog of n datagrams costs about n / kRecvBatchSize
+    /// syscalls instead of 2n.
+    /// \param[out] _buf Buffer that receives the newest datagram.
+    /// \param[in] _size Size of the buffer.
+    /// \param[in] _timeoutMs Milliseconds to wait for the first datagram.
+    /// \param[out] _dropped Number of older datagrams discarded.
+    /// \param[in] _wakeFd Optional descriptor that interrupts the wait
+    /// when it becomes readable, -1 for none.
+    /// \param[in] _order Picks the newest datagram, nullptr for arrival
+    /// order.
+    /// \return Size of the newest datagram, or -1 if none was received.
+    public: ssize_t RecvLatest(void *_buf, const size_t _size,
+      uint32_t _timeoutMs, uint32_t &_dropped, const int _wakeFd = -1,
+      const ArduPilotPacketOrder _order = nullptr)
+    {
+      _dropped = 0;
+      if (this->type == SOCK_SEQPACKET && this->connFd == -1)
+      {
+        // accept the controller connection first
+        if (!this->WaitReadable(this->fd, _timeoutMs, _wakeFd))
+        {
+          return -1;
+        }
+        this->connFd = accept(this->fd, nullptr, nullptr);
+        if (this->connFd == -1)
+        {
+          return -1;
+        }
+        this->ApplyOptions(this->connFd);
+        this->SetNonBlocking(this->connFd);
+      }
+
+      const int rfd = this->type == SOCK_SEQPACKET ? this->connFd : this->fd;
+      if (!this->WaitReadable(rfd, _timeoutMs, _wakeFd))
+      {
+        return -1;
+      }
+
+      if (this->ringSlotSize != _size)
+      {
+        this->ResizeRing(_size);
+      }
+
+      // size of the newest datagram, copied to _buf
+      ssize_t newestSize = -1;
+      uint32_t received = 0;
+      bool closed = false;
+
+      #ifdef __linux__
+      while (true)
+      {
+        const int n = recvmmsg(rfd, this->ringMsgs.data(),
+            kRecvBatchSize, MSG_DONTWAIT, nullptr);
+        if (n <= 0)
+        {
+          break;
+        }
+        // newest of the batch, the next batch reuses the ring
+        int best = -1;
+        for (int i = 0; i < n; ++i)
+        {
+          // a zero length record on a seqpacket socket means peer closed,
+          // records received before it are still valid
+          if (this->type == SOCK_SEQPACKET &&
+              this->ringMsgs[i].msg_len == 0)
+          {
+            closed = true;
+            break;
+          }
+          ++received;
+          if (best < 0 || !_order || _order(
+                &this->ringBuffer[i * this->ringSlotSize],
+                this->ringMsgs[i].msg_len,
+                &this->ringBuffer[best * this->ringSlotSize],
+                this->ringMsgs[best].msg_len))
+          {
+            best = i;
+          }
+        }
+        if (best >= 0)
+        {
+          const uint8_t *packet = &this->ringBuffer[best * this->ringSlotSize];
+          const ssize_t size = this->ringMsgs[best].msg_len;
+          if (newestSize < 0 || !_order ||
+              _order(packet, size, _buf, newestSize))
+          {
+            memcpy(_buf, packet, size);
+            newestSize = size;
+          }
+        }
+        if (closed || n < static_cast<int>(kRecvBatchSize))
+        {
+          break;
+        }
+      }
+      #else
+      // Socket is non-blocking, ping-pong between two ring slots so the
+      // newest datagram is never overwritten by a later receive.
+      size_t newestSlot = 0;
+      while (true)
+      {
+        const size_t slot = newestSize < 0 ? 0 : 1 - newestSlot;
+        const ssize_t n = recv(rfd, reinterpret_cast<raw_type *>(
+            &this->ringBuffer[slot * this->ringSlotSize]), _size, 0);
+        if (n < 0)
+        {
+          break;
+        }
+        if (n == 0 && this->type == SOCK_SEQPACKET)
+        {
+          closed = true;
+          break;
+        }
+        ++received;
+        if (newestSize < 0 || !_order || _order(
+              &this->ringBuffer[slot * this->ringSlotSize], n,
+              &this->ringBuffer[newestSlot * this->ringSlotSize],
+              newestSize))
+        {
+          newestSlot = slot;
+          newestSize = n;
+        }
+      }
+      if (newestSize >= 0)
+      {
+        memcpy(_buf, &this->ringBuffer[newestSlot * this->ringSlotSize],
+            newestSize);
+      }
+      #endif
+
+      if (closed)
+      {
+        this->Close(this->connFd);
+      }
+
+      if (newestSize < 0)
+      {
+        return -1;
+      }
+      _dropped = received - 1;
+      return newestSize;
+    }
+
+    /// \brief Create the socket
+    /// \return Socket handle, -1 on failure.
+    private: int NewSocket() const
+    {
+      const int s = socket(this->family, this->type, 0);
+      #ifndef _WIN32
+      // Windows does not support FD_CLOEXEC
+      if (s != -1)
+      {
+        fcntl(s, F_SETFD, FD_CLOEXEC);
+      }
+      #endif
+      return s;
+    }
+
+    /// \brief Replace the socket with a fresh unconnected one.
+    private: void Reopen()
+    {
+      this->Close(this->fd);
+      this->fd = this->NewSocket();
+      this->ApplyOptions(this->fd);
+      this->connected = false;
+    }
+
+    /// \brief Apply the socket options of tuning.
+    /// \param[in] _fd Socket descriptor.
+    private: void ApplyOptions(const int _fd) const
+    {
+      if (_fd == -1)
+      {
+        return;
+      }
+      if (this->receiving && this->tuning.recvBufferSize > 0)
+      {
+        setsockopt(_fd, SOL_SOCKET, SO_RCVBUF,
+            reinterpret_cast<const char *>(&this->tuning.recvBufferSize),
+            sizeof(this->tuning.recvBufferSize));
+      }
+      if (!this->receiving && this->tuning.sendBufferSize > 0)
+      {
+        setsockopt(_fd, SOL_SOCKET, SO_SNDBUF,
+            reinterpret_cast<const char *>(&this->tuning.sendBufferSize),
+            sizeof(this->tuning.sendBufferSize));
+      }
+      #ifdef __linux__
+      if (this->tuning.priority >= 0)
+      {
+        setsockopt(_fd, SOL_SOCKET, SO_PRIORITY,
+            &this->tuning.priority, sizeof(this->tuning.priority));
+      }
+      if (this->receiving && this->tuning.busyPollUs > 0)
+      {
+        setsockopt(_fd, SOL_SOCKET, SO_BUSY_POLL,
+            &this->tuning.busyPollUs, sizeof(this->tuning.busyPollUs));
+      }
+      #endif
+    }
+
+    /// \brief Connect to the remote address stored by Connect().
+    /// \return True if connected.
+    private: bool TryConnect()
+    {
+      if (!this->hasRemote || this->fd == -1)
+      {
+        return false;
+      }
+      if (connect(this->fd, (struct sockaddr *)&this->remote,
+            this->remoteLen) != 0)
+      {
+        if (this->type == SOCK_SEQPACKET)
+        {
+          // a failed stream connect leaves the socket unusable
+          this->Reopen();
+        }
+        return false;
+      }
+      this->SetNonBlocking(this->fd);
+      this->connected = true;
+      return true;
+    }
+
+    /// \brief Make a socket address
+    /// \param[in] _address IPv4 address, or unix socket path.
+    /// \param[in] _port Socket port, unused for unix sockets.
+    /// \param[out] _sockaddr New socket address structure.
+    /// \param[out] _len Length of _sockaddr.
+    /// \return True if the address is valid.
+    private: bool MakeSockAddr(const std::string &_address,
+      const uint16_t _port, struct sockaddr_storage &_sockaddr,
+      socklen_t &_len) const
+    {
+      memset(&_sockaddr, 0, sizeof(_sockaddr));
+
+      #ifndef _WIN32
+      if (this->family == AF_UNIX)
+      {
+        struct sockaddr_un *addr =
+          reinterpret_cast<struct sockaddr_un *>(&_sockaddr);
+        if (_address.empty() || _address.size() >= sizeof(addr->sun_path))
+        {
+          return false;
+        }
+        addr->sun_family = AF_UNIX;
+        memcpy(addr->sun_path, _address.c_str(), _address.size());
+        _len = offsetof(struct sockaddr_un, sun_path) + _address.size();
+        if (_address[0] == '@')
+        {
+          // abstract namespace, name is not nul terminated
+          addr->sun_path[0] = '\0';
+        }
+        else
+        {
+          _len += 1;
+        }
+        return true;
+      }
+      #endif
+
+      struct sockaddr_in *addr =
+        reinterpret_cast<struct sockaddr_in *>(&_sockaddr);
+      #ifdef HAVE_SOCK_SIN_LEN
+        addr->sin_len = sizeof(*addr);
+      #endif
+
+      addr->sin_port = htons(_port);
+      addr->sin_family = AF_INET;
+      addr->sin_addr.s_addr = inet_addr(_address.c_str());
+      _len = sizeof(*addr);
+      return true;
+    }
+
+    /// \brief Set a socket to non-blocking mode.
+    /// \param[in] _fd Socket handle.
+    private: void SetNonBlocking(const int _fd) const
+    {
+      #ifdef _WIN32
+      u_long on = 1;
+      ioctlsocket(_fd, FIONBIO,
+                reinterpret_cast<u_long FAR *>(&on));
+      #else
+      fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL, 0) | O_NONBLOCK);
+      #endif
+    }
+
+    /// \brief Close a socket handle and mark it invalid.
+    /// \param[in,out] _fd Socket handle.
+    private: void Close(int &_fd) const
+    {
+      if (_fd != -1)
+      {
+        #ifdef _WIN32
+        closesocket(_fd);
+        #else
+        ::close(_fd);
+        #endif
+        _fd = -1;
+      }
+    }
+
+    /// \brief Wait until a socket is readable.
+    /// Uses poll rather than select so descriptors above FD_SETSIZE
+    /// are supported.
+    /// \param[in] _fd Socket handle.
+    /// \param[in] _timeoutMs Milliseconds to wait.
+    /// \param[in] _wakeFd Optional descriptor that interrupts the wait,
+    /// -1 for none. Ignored on Windows.
+    /// \return True if data is available on the socket.
+    private: bool WaitReadable(const int _fd, uint32_t _timeoutMs,
+      const int _wakeFd)
+    {
+      #ifdef _WIN32
+      fd_set fds;
+      struct timeval tv;
+
+      FD_ZERO(&fds);
+      FD_SET(_fd, &fds);
+
+      tv.tv_sec = _timeoutMs / 1000;
+      tv.tv_usec = (_timeoutMs % 1000) * 1000UL;
+
+      (void)_wakeFd;
+      return select(_fd+1, &fds, NULL, NULL, &tv) == 1;
+      #else
+      struct pollfd pfds[2];
+      pfds[0].fd = _fd;
+      pfds[0].events = POLLIN;
+      pfds[0].revents = 0;
+      pfds[1].fd = _wakeFd;
+      pfds[1].events = POLLIN;
+      pfds[1].revents = 0;
+
+      const nfds_t nfds = _wakeFd >= 0 ? 2 : 1;
+      const bool waits = _timeoutMs > 0;
+
+      // Busy-poll first, a reply arriving within the budget then costs
+      // no scheduler wake-up.
+      if (this->tuning.spinUs > 0 && _timeoutMs > 0)
+      {
+        const auto spinEnd = std::chrono::steady_clock::now() +
+          std::chrono::microseconds(this->tuning.spinUs);
+        do
+        {
+          if (poll(pfds, nfds, 0) > 0)
+          {
+            ++this->stats.spinWakeups;
+            return (pfds[0].revents & (POLLIN | POLLHUP)) != 0;
+          }
+        }
+        while (std::chrono::steady_clock::now() < spinEnd);
+        const uint32_t spinMs = this->tuning.spinUs / 1000;
+        _timeoutMs = _timeoutMs > spinMs ? _timeoutMs - spinMs : 0;
+      }
+
+      if (poll(pfds, nfds, static_cast<int>(_timeoutMs)) > 0)
+      {
+        ++this->stats.blockWakeups;
+        return (pfds[0].revents & (POLLIN | POLLHUP)) != 0;
+      }
+      if (waits)
+      {
+        // a zero timeout is a probe, not an expired wait
+        ++this->stats.timeouts;
+      }
+      return false;
+      #endif
+    }
+
+    /// \brief Apply tuning options to the socket.
+    /// \param[in] _tuning Options.
+    /// \param[in] _receiving True for the receiving end.
+    public: void Configure(const ArduPilotTransportTuning &_tuning,
+      const bool _receiving)
+    {
+      this->tuning = _tuning;
+      this->receiving = _receiving;
+      this->ApplyOptions(this->fd);
+    }
+
+    /// \brief Descriptor packets are received on.
+    /// \return The connection once accepted for seqpacket sockets, the
+    /// bound socket otherwise.
+    public: int ReadableFd() const
+    {
+      return (this->type == SOCK_SEQPACKET && this->connFd != -1) ?
+        this->connFd : this->fd;
+    }
+
+    /// \brief Wait statistics of this socket.
+    /// \return Counters since construction.
+    public: const ArduPilotWaitStats &Stats() const
+    {
+      return this->stats;
+    }
+
+    /// \brief Allocate the receive ring and its message headers.
+    /// \param[in] _slotSize Size of one ring slot.
+    private: void ResizeRing(const size_t _slotSize)
+    {
+      this->ringSlotSize = _slotSize;
+      this->ringBuffer.assign(kRecvBatchSize * _slotSize, 0);
+      #ifdef __linux__
+      this->ringIovecs.resize(kRecvBatchSize);
+      this->ringMsgs.resize(kRecvBatchSize);
+      for (size_t i = 0; i < kRecvBatchSize; ++i)
+      {
+        this->ringIovecs[i].iov_base = &this->ringBuffer[i * _slotSize];
+        this->ringIovecs[i].iov_len = _slotSize;
+        memset(&this->ringMsgs[i], 0, sizeof(this->ringMsgs[i]));
+        this->ringMsgs[i].msg_hdr.msg_iov = &this->ringIovecs[i];
+        this->ringMsgs[i].msg_hdr.msg_iovlen = 1;
+      }
+      #endif
+    }
+
+    /// \brief Number of datagrams fetched per recvmmsg call
+    private: static const size_t kRecvBatchSize = 16;
+
+    /// \brief Address family
+    private: const int family;
+
+    /// \brief Socket type
+    private: const int type;
+
+    /// \brief Socket handle, listening socket for SOCK_SEQPACKET
+    private: int fd = -1;
+
+    /// \brief Accepted connection for SOCK_SEQPACKET
+    private: int connFd = -1;
+
+    /// \brief Socket file to remove on destruction
+    private: std::string boundPath;
+
+    /// \brief Destination stored by Connect()
+    private: struct sockaddr_storage remote;
+
+    /// \brief Length of remote
+    private: socklen_t remoteLen = 0;
+
+    /// \brief true once Connect() was called
+    private: bool hasRemote = false;
+
+    /// \brief true once connected to remote
+    private: bool connected = false;
+
+    /// \brief Wait policy and socket options
+    private: ArduPilotTransportTuning tuning;
+
+    /// \brief Wait statistics
+    private: ArduPilotWaitStats stats;
+
+    /// \brief True for the receiving end, selects the options to apply
+    private: bool receiving = false;
+
+    /// \brief Contiguous receive ring, kRecvBatchSize slots
+    private: std::vector<uint8_t> ringBuffer;
+
+    /// \brief Size of one slot of the receive ring
+    private: size_t ringSlotSize = 0;
+
+    #ifdef __linux__
+    /// \brief Scatter vectors pointing into the receive ring
+    private: std::vector<struct iovec> ringIovecs;
+
+    /// \brief recvmmsg message headers, one per ring slot
+    private: std::vector<struct mmsghdr> ringMsgs;
+    #endif
+  };
+
+  /// \brief Socket backend, one socket to receive and one to send.
+  class SocketTransport : public ArduPilotTransport
+  {
+    /// \brief Constructor
+    /// \param[in] _family AF_INET or AF_UNIX.
+    /// \param[in] _type SOCK_DGRAM or SOCK_SEQPACKET.
+    public: SocketTransport(const int _family, const int _type)
+      : socketIn(_family, _type), socketOut(_family, _type)
+    {
+    }
+
+    // Documentation inherited
+    public: bool Bind(const std::string &_address,
+        const uint16_t _port) override
+    {
+      return this->socketIn.Bind(_address, _port);
+    }
+
+    // Documentation inherited
+    public: bool Connect(const std::string &_address,
+        const uint16_t _port) override
+    {
+      return this->socketOut.Connect(_address, _port);
+    }
+
+    // Documentation inherited
+    public: ssize_t Send(const void *_buf, const size_t _size) override
+    {
+      return this->socketOut.Send(_buf, _size);
+    }
+
+    // Documentation inherited
+    public: ssize_t RecvLatest(void *_buf, const size_t _size,
+        uint32_t _timeoutMs, uint32_t &_dropped,
+        const int _wakeFd = -1) override
+    {
+      return this->socketIn.RecvLatest(_buf, _size, _timeoutMs, _dropped,
+          _wakeFd, this->packetOrder);
+    }
+
+    // Documentation inherited
+    public: bool SupportsWakeFd() const override
+    {
+      #ifdef _WIN32
+      return false;
+      #else
+      return true;
+      #endif
+    }
+
+    // Documentation inherited
+    public: void Configure(const ArduPilotTransportTuning &_tuning) override
+    {
+      this->socketIn.Configure(_tuning, true);
+      this->socketOut.Configure(_tuning, false);
+    }
+
+    // Documentation inherited
+    public: ArduPilotWaitStats WaitStats() const override
+    {
+      return this->socketIn.Stats();
+    }
+
+    // Documentation inherited
+    public: int ReadableFd() const override
+    {
+      return this->socketIn.ReadableFd();
+    }
+
+    /// \brief Socket receiving from the peer
+    private: ArduPilotSocket socketIn;
+
+    /// \brief Socket sending to the peer
+    private: ArduPilotSocket socketOut;
+  };
+
+  /// \brief Shared memory backend
+  class ShmTransport : public ArduPilotTransport
+  {
+    // Documentation inherited
+    public: bool Bind(const std::string &_address,
+        const uint16_t /*_port*/) override
+    {
+      return this->shm.Create(_address);
+    }
+
+    // Documentation inherited
+    public: bool Connect(const std::string &/*_address*/,
+        const uint16_t /*_port*/) override
+    {
+      // the segment created by Bind() carries both directions
+      return this->shm.IsOpen();
+    }
+
+    // Documentation inherited
+    public: ssize_t Send(const void *_buf, const size_t _size) override
+    {
+      return this->shm.Send(_buf, _size);
+    }
+
+    // Documentation inherited
+    public: ssize_t RecvLatest(void *_buf, const size_t _size,
+        uint32_t _timeoutMs, uint32_t &_dropped,
+        const int /*_wakeFd*/ = -1) override
+    {
+      return this->shm.RecvLatest(_buf, _size, _timeoutMs, _dropped);
+    }
+
+    // Documentation inherited
+    public: bool SupportsWakeFd() const override
+    {
+      return false;
+    }
+
+    // Documentation inherited
+    public: void Configure(const ArduPilotTransportTuning &_tuning) override
+    {
+      this->shm.SetSpinBudget(_tuning.spinUs);
+    }
+
+    // Documentation inherited
+    public: ArduPilotWaitStats WaitStats() const override
+    {
+      return this->shm.WaitStats();
+    }
+
+    /// \brief Shared memory segment
+    private: ArduPilotShm shm;
+  };
+
+  #ifndef _WIN32
+  /// \brief Flight stack loaded as a shared library and stepped in the
+  /// calling thread, see ArduPilotSitlLibrary.hh. Send() runs one step of
+  /// the flight stack on the caller's state buffer, RecvLatest() hands
+  /// out the servo packet it produced.
+  class InProcessTransport : public ArduPilotTransport
+  {
+    /// \brief Destructor
+    public: ~InProcessTransport()
+    {
+      if (this->sitl)
+      {
+        this->destroy(this->sitl);
+      }
+      if (this->library)
+      {
+        dlclose(this->library);
+      }
+    }
+
+    /// \brief Load the library.
+    /// \param[in] _address Library path, searched like dlopen() does.
+    /// \return True on success.
+    public: bool Bind(const std::string &_address,
+        const uint16_t /*_port*/) override
+    {
+      this->library = dlopen(_address.c_str(), RTLD_NOW | RTLD_LOCAL);
+      if (!this->library)
+      {
+        return false;
+      }
+      const auto version = reinterpret_cast<ap_sitl_abi_version_fn>(
+          dlsym(this->library, "ap_sitl_abi_version"));
+      this->create = reinterpret_cast<ap_sitl_create_fn>(
+          dlsym(this->library, "ap_sitl_create"));
+      this->step = reinterpret_cast<ap_sitl_step_fn>(
+          dlsym(this->library, "ap_sitl_step"));
+      this->destroy = reinterpret_cast<ap_sitl_destroy_fn>(
+          dlsym(this->library, "ap_sitl_destroy"));
+      return version && this->create && this->step && this->destroy &&
+        version() == AP_SITL_ABI_VERSION;
+    }
+
+    /// \brief Create the flight stack instance.
+    /// \param[in] _address Instance arguments.
+    /// \return True on success.
+    public: bool Connect(const std::string &_address,
+        const uint16_t /*_port*/) override
+    {
+      if (!this->create)
+      {
+        return false;
+      }
+      this->sitl = this->create(_address.c_str());
+      return this->sitl != nullptr;
+    }
+
+    // Documentation inherited
+    public: ssize_t Send(const void *_buf, const size_t _size) override
+    {
+      if (!this->sitl)
+      {
+        return -1;
+      }
+      this->servoSize = this->step(this->sitl, _buf, _size,
+          this->servo, sizeof(this->servo));
+      return this->servoSize < 0 ? -1 : static_cast<ssize_t>(_size);
+    }
+
+    // Documentation inherited
+    public: ssize_t RecvLatest(void *_buf, const size_t _size,
+        uint32_t /*_timeoutMs*/, uint32_t &_dropped,
+        const int /*_wakeFd*/ = -1) override
+    {
+      _dropped = 0;
+      if (!this->sitl)
+      {
+        return -1;
+      }
+      if (this->servoSize < 0)
+      {
+        // no state sent since the last command, e.g. before the first
+        // step, ask for the flight stack's initial command
+        this->servoSize = this->step(this->sitl, nullptr, 0,
+            this->servo, sizeof(this->servo));
+        if (this->servoSize < 0)
+        {
+          return -1;
+        }
+      }
+      const size_t size =
+        std::min(static_cast<size_t>(this->servoSize), _size);
+      memcpy(_buf, this->servo, size);
+      this->servoSize = -1;
+      return static_cast<ssize_t>(size);
+    }
+
+    // Documentation inherited
+    public: bool SupportsWakeFd() const override
+    {
+      return false;
+    }
+
+    /// \brief Library handle
+    private: void *library = nullptr;
+
+    /// \brief Flight stack instance
+    private: ap_sitl *sitl = nullptr;
+
+    /// \brief ap_sitl_create
+    private: ap_sitl_create_fn create = nullptr;
+
+    /// \brief ap_sitl_step
+    private: ap_sitl_step_fn step = nullptr;
+
+    /// \brief ap_sitl_destroy
+    private: ap_sitl_destroy_fn destroy = nullptr;
+
+    /// \brief Servo packet of the last step. The ABI produces the servo
+    /// packet in the same call that consumes the state, which Send() makes
+    /// before RecvLatest() names the destination, so the packet is staged
+    /// here and copied once, a few dozen bytes.
+    private: uint8_t servo[2048];
+
+    /// \brief Size of servo, -1 if already handed out
+    private: int servoSize = -1;
+  };
+
+  /// \brief Header prepended to every packet on a multiplexed endpoint
+  struct MuxHeader
+  {
+    /// \brief kMuxMagic
+    uint32_t magic;
+
+    /// \brief Vehicle the packet belongs to
+    uint16_t vehicleId;
+
+    /// \brief Unused, zero
+    uint16_t reserved;
+  };
+
+  /// \brief Multiplexed packet identifier, "APMX"
+  const uint32_t kMuxMagic = 0x584d5041;
+
+  /// \brief Largest payload carried per vehicle
+  const size_t kMuxMaxPayload = 2048;
+
+  /// \brief Size of one multiplexed datagram buffer
+  const size_t kMuxSlotSize = sizeof(MuxHeader) + kMuxMaxPayload;
+
+  /// \brief One UDP socket shared by every vehicle of a world.
+  ///
+  /// Outgoing packets are queued and leave in a single sendmmsg once
+  /// every registered vehicle has queued one, or before any receive has
+  /// to block. Incoming packets are drained with recvmmsg and sorted into
+  /// per-vehicle slots, so the first vehicle to receive in a step usually
+  /// fetches the packets of all the others too.
+  class MuxEndpoint
+  {
+    /// \brief Per vehicle state
+    private: struct Vehicle
+    {
+      /// \brief Address of the vehicle's ArduPilot instance
+      struct sockaddr_in remote;
+
+      /// \brief Outgoing datagram, header + payload
+      std::vector<uint8_t> txBuffer;
+
+      /// \brief true while txBuffer waits in the send queue
+      bool txPending = false;
+
+      /// \brief Newest received payload
+      std::vector<uint8_t> rxBuffer;
+
+      /// \brief Size of the payload in rxBuffer
+      ssize_t rxSize = -1;
+
+      /// \brief Packets overwritten in rxBuffer before being read
+      uint32_t rxDropped = 0;
+
+      /// \brief Picks the newest payload, nullptr for arrival order
+      ArduPilotPacketOrder order = nullptr;
+    };
+
+    /// \brief Get the endpoint bound to an address, creating it on first
+    /// use.
+    /// \param[in] _address Local IPv4 address.
+    /// \param[in] _port Local port.
+    /// \return The endpoint, or nullptr if binding failed.
+    public: static std::shared_ptr<MuxEndpoint> Get(
+        const std::string &_address, const uint16_t _port)
+    {
+      static std::mutex registryMutex;
+      static std::map<std::pair<std::string, uint16_t>,
+          std::weak_ptr<MuxEndpoint>> registry;
+
+      std::lock_guard<std::mutex> lock(registryMutex);
+      const auto key = std::make_pair(_address, _port);
+      std::shared_ptr<MuxEndpoint> endpoint = registry[key].lock();
+      if (!endpoint)
+      {
+        endpoint.reset(new MuxEndpoint);
+        if (!endpoint->Bind(_address, _port))
+        {
+          return nullptr;
+        }
+        registry[key] = endpoint;
+      }
+      return endpoint;
+    }
+
+    /// \brief Destructor
+    public: ~MuxEndpoint()
+    {
+      if (this->fd != -1)
+      {
+        ::close(this->fd);
+      }
+    }
+
+    /// \brief Add a vehicle.
+    /// \param[in] _id Vehicle id, unique on this endpoint.
+    /// \param[in] _address IPv4 address of the vehicle's ArduPilot.
+    /// \param[in] _port Port of the vehicle's ArduPilot.
+    /// \return False if the id is already taken.
+    public: bool Register(const uint16_t _id, const std::string &_address,
+        const uint16_t _port)
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      if (this->vehicles.count(_id))
+      {
+        return false;
+      }
+      Vehicle &vehicle = this->vehicles[_id];
+      memset(&vehicle.remote, 0, sizeof(vehicle.remote));
+      vehicle.remote.sin_family = AF_INET;
+      vehicle.remote.sin_port = htons(_port);
+      vehicle.remote.sin_addr.s_addr = inet_addr(_address.c_str());
+      vehicle.txBuffer.assign(kMuxSlotSize, 0);
+      vehicle.rxBuffer.assign(kMuxMaxPayload, 0);
+      MuxHeader header;
+      header.magic = kMuxMagic;
+      header.vehicleId = _id;
+      header.reserved = 0;
+      memcpy(vehicle.txBuffer.data(), &header, sizeof(header));
+      this->txMsgs.reserve(this->vehicles.size());
+      this->txIovecs.reserve(this->vehicles.size());
+      return true;
+    }
+
+    /// \brief Remove a vehicle.
+    /// \param[in] _id Vehicle id.
+    public: void Unregister(const uint16_t _id)
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      this->FlushLocked();
+      this->vehicles.erase(_id);
+    }
+
+    /// \brief Queue a packet for a vehicle.
+    /// \param[in] _id Vehicle id.
+    /// \param[in] _buf Payload.
+    /// \param[in] _size Payload size.
+    /// \return _size, or -1 if the vehicle is unknown or _size too large.
+    public: ssize_t Send(const uint16_t _id, const void *_buf,
+        const size_t _size)
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      auto it = this->vehicles.find(_id);
+      if (it == this->vehicles.end() || _size > kMuxMaxPayload)
+      {
+        return -1;
+      }
+      Vehicle &vehicle = it->second;
+      if (vehicle.txPending)
+      {
+        // second packet in the same round, push out the first one
+        this->FlushLocked();
+      }
+      memcpy(vehicle.txBuffer.data() + sizeof(MuxHeader), _buf, _size);
+      this->QueueLocked(vehicle, sizeof(MuxHeader) + _size);
+      if (this->txMsgs.size() == this->vehicles.size())
+      {
+        this->FlushLocked();
+      }
+      return static_cast<ssize_t>(_size);
+    }
+
+    /// \brief Get the newest packet of a vehicle, receiving if needed.
+    /// \param[in] _id Vehicle id.
+    /// \param[out] _buf Buffer that receives the payload.
+    /// \param[in] _size Size of the buffer.
+    /// \param[in] _timeoutMs Milliseconds to wait.
+    /// \param[out] _dropped Packets for this vehicle discarded.
+    /// \param[in] _order Picks the newest payload, nullptr for arrival
+    /// order.
+    /// \return Payload size, or -1 if none was received.
+    public: ssize_t RecvLatest(const uint16_t _id, void *_buf,
+        const size_t _size, uint32_t _timeoutMs, uint32_t &_dropped,
+        const ArduPilotPacketOrder _order)
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      _dropped = 0;
+      auto it = this->vehicles.find(_id);
+      if (it == this->vehicles.end())
+      {
+        return -1;
+      }
+      Vehicle &vehicle = it->second;
+      vehicle.order = _order;
+
+      const auto deadline = std::chrono::steady_clock::now() +
+        std::chrono::milliseconds(_timeoutMs);
+      this->DrainLocked();
+      while (vehicle.rxSize < 0)
+      {
+        // replies can only come once our queued state went out
+        this->FlushLocked();
+        const auto remaining =
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        struct pollfd pfd;
+        pfd.fd = this->fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (remaining < 0 ||
+            poll(&pfd, 1, static_cast<int>(remaining)) <= 0)
+        {
+          return -1;
+        }
+        this->DrainLocked();
+      }
+
+      const ssize_t size = std::min(vehicle.rxSize,
+          static_cast<ssize_t>(_size));
+      memcpy(_buf, vehicle.rxBuffer.data(), size);
+      _dropped = vehicle.rxDropped;
+      vehicle.rxSize = -1;
+      vehicle.rxDropped = 0;
+      return size;
+    }
+
+    /// \brief Create and bind the socket.
+    /// \param[in] _address Local IPv4 address.
+    /// \param[in] _port Local port.
+    /// \return True on success.
+    private: bool Bind(const std::string &_address, const uint16_t _port)
+    {
+      this->fd = socket(AF_INET, SOCK_DGRAM, 0);
+      if (this->fd == -1)
+      {
+        return false;
+      }
+      fcntl(this->fd, F_SETFD, FD_CLOEXEC);
+
+      struct sockaddr_in addr;
+      memset(&addr, 0, sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons(_port);
+      addr.sin_addr.s_addr = inet_addr(_address.c_str());
+      if (bind(this->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+      {
+        return false;
+      }
+      fcntl(this->fd, F_SETFL, fcntl(this->fd, F_GETFL, 0) | O_NONBLOCK);
+
+      this->rxBuffer.assign(kRecvBatchSize * kMuxSlotSize, 0);
+      #ifdef __linux__
+      this->rxIovecs.resize(kRecvBatchSize);
+      this->rxMsgs.resize(kRecvBatchSize);
+      for (size_t i = 0; i < kRecvBatchSize; ++i)
+      {
+        this->rxIovecs[i].iov_base = &this->rxBuffer[i * kMuxSlotSize];
+        this->rxIovecs[i].iov_len = kMuxSlotSize;
+        memset(&this->rxMsgs[i], 0, sizeof(this->rxMsgs[i]));
+        this->rxMsgs[i].msg_hdr.msg_iov = &this->rxIovecs[i];
+        this->rxMsgs[i].msg_hdr.msg_iovlen = 1;
+      }
+      #endif
+      return true;
+    }
+
+    /// \brief Add a vehicle's datagram to the send queue.
+    /// \param[in] _vehicle Vehicle.
+    /// \param[in] _size Datagram size, header included.
+    private: void QueueLocked(Vehicle &_vehicle, const size_t _size)
+    {
+      struct iovec iov;
+      iov.iov_base = _vehicle.txBuffer.data();
+      iov.iov_len = _size;
+      this->txIovecs.push_back(iov);
+      #ifdef __linux__
+      struct mmsghdr msg;
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_hdr.msg_name = &_vehicle.remote;
+      msg.msg_hdr.msg_namelen = sizeof(_vehicle.remote);
+      this->txMsgs.push_back(msg);
+      #else
+      this->txMsgs.push_back(&_vehicle);
+      #endif
+      _vehicle.txPending = true;
+    }
+
+    /// \brief Send every queued datagram.
+    private: void FlushLocked()
+    {
+      if (this->txMsgs.empty())
+      {
+        return;
+      }
+      #ifdef __linux__
+      // iovec storage is stable now, link it into the headers
+      for (size_t i = 0; i < this->txMsgs.size(); ++i)
+      {
+        this->txMsgs[i].msg_hdr.msg_iov = &this->txIovecs[i];
+        this->txMsgs[i].msg_hdr.msg_iovlen = 1;
+      }
+      size_t sent = 0;
+      while (sent < this->txMsgs.size())
+      {
+        const int n = sendmmsg(this->fd, &this->txMsgs[sent],
+            this->txMsgs.size() - sent, 0);
+        if (n <= 0)
+        {
+          break;
+        }
+        sent += n;
+      }
+      #else
+      for (size_t i = 0; i < this->txMsgs.size(); ++i)
+      {
+        sendto(this->fd, this->txIovecs[i].iov_base,
+            this->txIovecs[i].iov_len, 0,
+            (struct sockaddr *)&this->txMsgs[i]->remote,
+            sizeof(this->txMsgs[i]->remote));
+      }
+      #endif
+      for (auto &v : this->vehicles)
+      {
+        v.second.txPending = false;
+      }
+      this->txMsgs.clear();
+      this->txIovecs.clear();
+    }
+
+    /// \brief Read every queued datagram into the vehicle slots.
+    private: void DrainLocked()
+    {
+      #ifdef __linux__
+      while (true)
+      {
+        const int n = recvmmsg(this->fd, this->rxMsgs.data(),
+            kRecvBatchSize, MSG_DONTWAIT, nullptr);
+        if (n <= 0)
+        {
+          break;
+        }
+        for (int i = 0; i < n; ++i)
+        {
+          this->Dispatch(&this->rxBuffer[i * kMuxSlotSize],
+              this->rxMsgs[i].msg_len);
+        }
+        if (n < static_cast<int>(kRecvBatchSize))
+        {
+          break;
+        }
+      }
+      #else
+      while (true)
+      {
+        const ssize_t n = recv(this->fd, this->rxBuffer.data(),
+            kMuxSlotSize, 0);
+        if (n < 0)
+        {
+          break;
+        }
+        this->Dispatch(this->rxBuffer.data(), n);
+      }
+      #endif
+    }
+
+    /// \brief Store a received datagram in its vehicle's slot.
+    /// \param[in] _data Datagram.
+    /// \param[in] _size Datagram size.
+    private: void Dispatch(const uint8_t *_data, const size_t _size)
+    {
+      if (_size < sizeof(MuxHeader))
+      {
+        return;
+      }
+      MuxHeader header;
+      memcpy(&header, _data, sizeof(header));
+      if (header.magic != kMuxMagic)
+      {
+        return;
+      }
+      auto it = this->vehicles.find(header.vehicleId);
+      if (it == this->vehicles.end())
+      {
+        return;
+      }
+      Vehicle &vehicle = it->second;
+      const uint8_t *payload = _data + sizeof(MuxHeader);
+      const size_t payloadSize = _size - sizeof(MuxHeader);
+      if (vehicle.rxSize >= 0)
+      {
+        ++vehicle.rxDropped;
+        if (vehicle.order && !vehicle.order(payload, payloadSize,
+              vehicle.rxBuffer.data(), vehicle.rxSize))
+        {
+          // stale packet, keep the newer one already stored
+          return;
+        }
+      }
+      vehicle.rxSize = payloadSize;
+      memcpy(vehicle.rxBuffer.data(), payload, vehicle.rxSize);
+    }
+
+    /// \brief Number of datagrams fetched per recvmmsg call
+    private: static const size_t kRecvBatchSize = 64;
+
+    /// \brief Protects everything below, vehicles may use I/O threads
+    private: std::mutex mutex;
+
+    /// \brief Socket handle
+    private: int fd = -1;
+
+    /// \brief Registered vehicles
+    private: std::unordered_map<uint16_t, Vehicle> vehicles;
+
+    /// \brief Scatter vectors of the queued datagrams
+    private: std::vector<struct iovec> txIovecs;
+
+    #ifdef __linux__
+    /// \brief sendmmsg headers of the queued datagrams
+    private: std::vector<struct mmsghdr> txMsgs;
+
+    /// \brief Scatter vectors pointing into rxBuffer
+    private: std::vector<struct iovec> rxIovecs;
+
+    /// \brief recvmmsg message headers, one per rxBuffer slot
+    private: std::vector<struct mmsghdr> rxMsgs;
+    #else
+    /// \brief Vehicles of the queued datagrams
+    private: std::vector<Vehicle *> txMsgs;
+    #endif
+
+    /// \brief Receive ring, kRecvBatchSize slots of kMuxSlotSize
+    private: std::vector<uint8_t> rxBuffer;
+  };
+
+  /// \brief Multiplexed backend, one vehicle on a shared MuxEndpoint
+  class MuxTransport : public ArduPilotTransport
+  {
+    /// \brief Constructor
+    /// \param[in] _vehicleId Vehicle id tagged on every packet.
+    public: explicit MuxTransport(const uint16_t _vehicleId)
+      : vehicleId(_vehicleId)
+    {
+    }
+
+    /// \brief Destructor
+    public: ~MuxTransport()
+    {
+      if (this->endpoint && this->registered)
+      {
+        this->endpoint->Unregister(this->vehicleId);
+      }
+    }
+
+    // Documentation inherited
+    public: bool Bind(const std::string &_address,
+        const uint16_t _port) override
+    {
+      this->endpoint = MuxEndpoint::Get(_address, _port);
+      return this->endpoint != nullptr;
+    }
+
+    // Documentation inherited
+    public: bool Connect(const std::string &_address,
+        const uint16_t _port) override
+    {
+      this->registered = this->endpoint &&
+        this->endpoint->Register(this->vehicleId, _address, _port);
+      return this->registered;
+    }
+
+    // Documentation inherited
+    public: ssize_t Send(const void *_buf, const size_t _size) override
+    {
+      return this->endpoint->Send(this->vehicleId, _buf, _size);
+    }
+
+    // Documentation inherited
+    public: ssize_t RecvLatest(void *_buf, const size_t _size,
+        uint32_t _timeoutMs, uint32_t &_dropped,
+        const int /*_wakeFd*/ = -1) override
+    {
+      return this->endpoint->RecvLatest(this->vehicleId, _buf, _size,
+          _timeoutMs, _dropped, this->packetOrder);
+    }
+
+    // Documentation inherited
+    public: bool SupportsWakeFd() const override
+    {
+      return false;
+    }
+
+    // ReadableFd() is not overridden: the shared socket turns readable for
+    // any vehicle and is emptied by whichever one receives first, so it
+    // cannot tell when this vehicle has a packet. Mux vehicles wait in
+    // their own RecvLatest() under <lockstepBarrier>.
+
+    /// \brief Vehicle id
+    private: const uint16_t vehicleId;
+
+    /// \brief Shared endpoint
+    private: std::shared_ptr<MuxEndpoint> endpoint;
+
+    /// \brief true once registered with endpoint
+    private: bool registered = false;
+  };
+  #endif
+}
+
+/////////////////////////////////////////////////
+std::unique_ptr<ArduPilotTransport> ArduPilotTransport::Create(
+    const std::string &_type, const uint16_t _vehicleId)
+{
+  if (_type == "udp")
+  {
+    return std::unique_ptr<ArduPilotTransport>(
+        new SocketTransport(AF_INET, SOCK_DGRAM));
+  }
+  #ifndef _WIN32
+  else if (_type == "unix")
+  {
+    return std::unique_ptr<ArduPilotTransport>(
+        new SocketTransport(AF_UNIX, SOCK_DGRAM));
+  }
+  else if (_type == "unix_seqpacket")
+  {
+    return std::unique_ptr<ArduPilotTransport>(
+        new SocketTransport(AF_UNIX, SOCK_SEQPACKET));
+  }
+  else if (_type == "shm")
+  {
+    return std::unique_ptr<ArduPilotTransport>(new ShmTransport);
+  }
+  else if (_type == "mux")
+  {
+    return std::unique_ptr<ArduPilotTransport>(new MuxTransport(_vehicleId));
+  }
+  else if (_type == "inprocess")
+  {
+    return std::unique_ptr<ArduPilotTransport>(new InProcessTransport);
+  }
+  #endif
+  return nullptr;
+}
@@ -0,0 +1,362 @@
+/*
+ * Copyright (C) 2026 ardupilot_sitl_gazebo contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gazebo/common/Assert.hh>
+#include <gazebo/common/Plugin.hh>
+#include <gazebo/physics/physics.hh>
+#include "include/ArduPilotTrace.hh"
+#include "include/MultirotorAeroPlugin.hh"
+#include "include/MultirotorAeroRotor.hh"
+#include "include/WindFieldPlugin.hh"
+
+using namespace gazebo;
+
+GZ_REGISTER_MODEL_PLUGIN(MultirotorAeroPlugin)
+
+/// \brief Parse a whitespace separated list of numbers.
+/// \param[in] _sdf Parent element.
+/// \param[in] _name Child element holding the list.
+/// \return The numbers, empty if the element is missing.
+static std::vector<double> ReadList(sdf::ElementPtr _sdf,
+    const std::string &_name)
+{
+  std::vector<double> values;
+  if (!_sdf->HasElement(_name))
+  {
+    return values;
+  }
+  std::istringstream stream(_sdf->Get<std::string>(_name));
+  double value;
+  while (stream >> value)
+  {
+    values.push_back(value);
+  }
+  return values;
+}
+
+/// \brief CT and CP against advance ratio, resampled on a uniform grid so
+/// a lookup is one multiply and one linear interpolation.
+class PropellerMap
+{
+  /// \brief Number of grid points
+  public: static const size_t kSize = 64;
+
+  /// \brief Resample a map.
+  /// \param[in] _j Increasing advance ratio samples.
+  /// \param[in] _ct Thrust coefficient at each sample.
+  /// \param[in] _cp Power coefficient at each sample.
+  /// \return False if the samples are inconsistent.
+  public: bool Build(const std::vector<double> &_j,
+      const std::vector<double> &_ct, const std::vector<double> &_cp)
+  {
+    if (_j.empty() || _j.size() != _ct.size() || _j.size() != _cp.size())
+    {
+      return false;
+    }
+    for (size_t i = 1; i < _j.size(); ++i)
+    {
+      if (!(_j[i] > _j[i - 1]))
+      {
+        return false;
+      }
+    }
+
+    this->j0 = _j.front();
+    const double span = _j.back() - _j.front();
+    this->invStep = span > 0.0 ? (kSize - 1) / span : 0.0;
+
+    size_t k = 0;
+    for (size_t i = 0; i < kSize; ++i)
+    {
+      const double j = this->j0 + span * i / (kSize - 1);
+      while (k + 2 < _j.size() && j > _j[k + 1])
+      {
+        ++k;
+      }
+      if (_j.size() == 1)
+      {
+        this->ct[i] = _ct[0];
+        this->cp[i] = _cp[0];
+        continue;
+      }
+      const double t = std::max(0.0, std::min(1.0,
+          (j - _j[k]) / (_j[k + 1] - _j[k])));
+      this->ct[i] = _ct[k] + t * (_ct[k + 1] - _ct[k]);
+      this->cp[i] = _cp[k] + t * (_cp[k + 1] - _cp[k]);
+    }
+    return true;
+  }
+
+  /// \brief Look up the coefficients, clamped to the map range.
+  /// \param[in] _j Advance ratio.
+  /// \param[out] _ct Thrust coefficient.
+  /// \param[out] _cp Power coefficient.
+  public: void Lookup(const double _j, double &_ct, double &_cp) const
+  {
+    const double x = std::max(0.0, std::min(static_cast<double>(kSize - 1),
+        (_j - this->j0) * this->invStep));
+    const size_t i = std::min(static_cast<size_t>(x), kSize - 2);
+    const double t = x - i;
+    _ct = this->ct[i] + t * (this->ct[i + 1] - this->ct[i]);
+    _cp = this->cp[i] + t * (this->cp[i + 1] - this->cp[i]);
+  }
+
+  /// \brief First advance ratio of the grid
+  private: double j0 = 0.0;
+
+  /// \brief Grid points per unit advance ratio
+  private: double invStep = 0.0;
+
+  /// \brief Thrust coefficient on the grid
+  private: double ct[kSize] = {};
+
+  /// \brief Power coefficient on the grid
+  private: double cp[kSize] = {};
+};
+
+/// \brief Private data class
+class gazebo::MultirotorAeroPluginPrivate
+{
+  /// \brief Compute and apply the forces of every rotor.
+  public: void Update();
+
+  /// \brief World update connection
+  public: event::ConnectionPtr updateConnection;
+
+  /// \brief Parent model
+  public: physics::ModelPtr model;
+
+  /// \brief Propeller performance map
+  public: PropellerMap map;
+
+  /// \brief Air density
+  public: double rho = 1.2041;
+
+  /// \brief Propeller diameter
+  public: double diameter = 0.254;
+
+  /// \brief Rotor drag coefficient
+  public: double rotorDrag = 0.0;
+
+  /// \brief Joint speed to rotor speed factor
+  public: double slowdown = 1.0;
+
+  /// \brief Wind field of the world, looked up on first update
+  public: std::shared_ptr<const WindField> wind;
+
+  /// \brief True once the wind field was looked up
+  public: bool windLookedUp = false;
+
+  /// \brief Rotor joint
+  public: std::vector<physics::JointPtr> joints;
+
+  /// \brief Airframe link of each rotor
+  public: std::vector<physics::LinkPtr> parents;
+
+  /// \brief Rotor link
+  public: std::vector<physics::LinkPtr> children;
+
+  /// \brief +1 for ccw, -1 for cw propellers
+  public: std::vector<double> direction;
+
+  /// \brief Rotor speed of the step, rad/s
+  public: std::vector<double> speed;
+
+  /// \brief Joint axis of the step, world frame
+  public: std::vector<ignition::math::Vector3d> axis;
+
+  /// \brief Hub position of the step, world frame
+  public: std::vector<ignition::math::Vector3d> position;
+
+  /// \brief Hub velocity relative to the air of the step, world frame
+  public: std::vector<ignition::math::Vector3d> velocity;
+
+  /// \brief Force of the step, world frame
+  public: std::vector<ignition::math::Vector3d> force;
+
+  /// \brief Reaction torque of the step, world frame
+  public: std::vector<ignition::math::Vector3d> torque;
+};
+
+/////////////////////////////////////////////////
+MultirotorAeroPlugin::MultirotorAeroPlugin()
+  : dataPtr(new MultirotorAeroPluginPrivate)
+{
+}
+
+/////////////////////////////////////////////////
+MultirotorAeroPlugin::~MultirotorAeroPlugin()
+{
+}
+
+/////////////////////////////////////////////////
+void MultirotorAeroPlugin::Load(physics::ModelPtr _model,
+    sdf::ElementPtr _sdf)
+{
+  GZ_ASSERT(_model, "MultirotorAeroPlugin _model pointer is null");
+  GZ_ASSERT(_sdf, "MultirotorAeroPlugin _sdf pointer is null");
+
+  this->dataPtr->model = _model;
+  const std::string modelName = _model->GetName();
+
+  this->dataPtr->rho = _sdf->Get("air_density", this->dataPtr->rho).first;
+  this->dataPtr->rotorDrag =
+    _sdf->Get("rotor_drag_coefficient", this->dataPtr->rotorDrag).first;
+  this->dataPtr->slowdown = _sdf->Get("rotor_velocity_slowdown_sim",
+      this->dataPtr->slowdown).first;
+
+  if (!_sdf->HasElement("propeller"))
+  {
+    gzerr << "[" << modelName << "] "
+          << "<propeller> not specified, no rotor forces applied.\n";
+    return;
+  }
+  sdf::ElementPtr propellerSDF = _sdf->GetElement("propeller");
+  this->dataPtr->diameter =
+    propellerSDF->Get("diameter", this->dataPtr->diameter).first;
+  if (!this->dataPtr->map.Build(ReadList(propellerSDF, "advance_ratio"),
+        ReadList(propellerSDF, "thrust_coefficient"),
+        ReadList(propellerSDF, "power_coefficient")))
+  {
+    gzerr << "[" << modelName << "] "
+          << "<advance_ratio>, <thrust_coefficient> and <power_coefficient>"
+          << " must have the same number of values, with increasing"
+          << " advance ratios. No rotor forces applied.\n";
+    return;
+  }
+
+  sdf::ElementPtr rotorSDF;
+  if (_sdf->HasElement("rotor"))
+  {
+    rotorSDF = _sdf->GetElement("rotor");
+  }
+  while (rotorSDF)
+  {
+    const std::string jointName =
+      rotorSDF->Get("joint", std::string()).first;
+    physics::JointPtr joint = _model->GetJoint(jointName);
+    if (joint == nullptr)
+    {
+      gzerr << "[" << modelName << "] "
+            << "Couldn't find rotor joint [" << jointName << "].\n";
+    }
+    else
+    {
+      const std::string direction =
+        rotorSDF->Get("direction", std::string("ccw")).first;
+      if (direction != "ccw" && direction != "cw")
+      {
+        gzwarn << "[" << modelName << "] "
+               << "rotor [" << jointName << "] direction [" << direction
+               << "] not recognized, must be ccw or cw. default to ccw.\n";
+      }
+      this->dataPtr->joints.push_back(joint);
+      this->dataPtr->parents.push_back(joint->GetParent());
+      this->dataPtr->children.push_back(joint->GetChild());
+      this->dataPtr->direction.push_back(direction == "cw" ? -1.0 : 1.0);
+    }
+    rotorSDF = rotorSDF->GetNextElement("rotor");
+  }
+
+  const size_t n = this->dataPtr->joints.size();
+  this->dataPtr->speed.resize(n);
+  this->dataPtr->axis.resize(n);
+  this->dataPtr->position.resize(n);
+  this->dataPtr->velocity.resize(n);
+  this->dataPtr->force.resize(n);
+  this->dataPtr->torque.resize(n);
+
+  gzlog << "[" << modelName << "] "
+        << "aerodynamics of " << n << " rotors.\n";
+
+  this->dataPtr->updateConnection = event::Events::ConnectWorldUpdateBegin(
+      std::bind(&MultirotorAeroPlugin::OnUpdate, this));
+}
+
+/////////////////////////////////////////////////
+void MultirotorAeroPlugin::OnUpdate()
+{
+  this->dataPtr->Update();
+}
+
+/////////////////////////////////////////////////
+void MultirotorAeroPluginPrivate::Update()
+{
+  AP_TRACE_SCOPE("MultirotorAeroPlugin::Update");
+  const size_t n = this->joints.size();
+
+  physics::WorldPtr world = this->model->GetWorld();
+  if (!this->windLookedUp)
+  {
+    this->wind = WindField::Find(world->Name());
+    this->windLookedUp = true;
+  }
+  // the vehicle is small against the grid, one sample covers every rotor
+  const ignition::math::Vector3d windVel = this->wind ?
+    this->wind->Velocity(this->model->WorldPose().Pos(),
+        world->SimTime().Double()) : ignition::math::Vector3d::Zero;
+
+  // gather rotor states
+  for (size_t i = 0; i < n; ++i)
+  {
+    this->speed[i] = this->joints[i]->GetVelocity(0) * this->slowdown;
+    this->axis[i] = this->joints[i]->GlobalAxis(0);
+    this->position[i] = this->children[i]->WorldPose().Pos();
+    this->velocity[i] = this->children[i]->WorldLinearVel() - windVel;
+  }
+
+  const double d4 = std::pow(this->diameter, 4);
+  const double d5 = d4 * this->diameter;
+  for (size_t i = 0; i < n; ++i)
+  {
+    const double w = this->speed[i];
+    const double revs = std::fabs(w) / (2.0 * IGN_PI);
+
+    const ignition::math::Vector3d thrustAxis =
+      this->axis[i] * RotorThrustSense(this->direction[i], w);
+
+    const double vAxial = this->velocity[i].Dot(thrustAxis);
+    const double j = revs > 1e-3 ? vAxial / (revs * this->diameter) : 0.0;
+    double ct;
+    double cp;
+    this->map.Lookup(j, ct, cp);
+
+    const double n2 = revs * revs;
+    const double thrust = ct * this->rho * n2 * d4;
+    const double drag = cp * this->rho * n2 * d5 / (2.0 * IGN_PI);
+
+    const ignition::math::Vector3d inPlane =
+      this->velocity[i] - this->axis[i] * this->velocity[i].Dot(this->axis[i]);
+    this->force[i] = thrustAxis * thrust -
+      inPlane * (this->rotorDrag * std::fabs(w));
+    this->torque[i] = this->axis[i] * (w >= 0.0 ? -drag : drag);
+  }
+
+  // scatter to the airframe
+  for (size_t i = 0; i < n; ++i)
+  {
+    this->parents[i]->AddForceAtWorldPosition(
+        this->force[i], this->position[i]);
+    this->parents[i]->AddTorque(this->torque[i]);
+  }
+}
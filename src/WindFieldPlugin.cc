@@ -0,0 +1,379 @@
+/*
+ * Copyright (C) 2026 ardupilot_sitl_gazebo contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gazebo/common/Assert.hh>
+#include <gazebo/common/Plugin.hh>
+#include <gazebo/physics/physics.hh>
+#include "include/WindFieldPlugin.hh"
+
+using namespace gazebo;
+
+GZ_REGISTER_WORLD_PLUGIN(WindFieldPlugin)
+
+/// \brief Nodes per tile side
+static const int kTile = 4;
+
+/// \brief Fields of the loaded worlds
+static std::map<std::string, std::weak_ptr<const WindField>> registry;
+
+/// \brief Protects registry
+static std::mutex registryMutex;
+
+/////////////////////////////////////////////////
+void WindGrid::Resize(const int _nx, const int _ny, const int _nz,
+    const ignition::math::Vector3d &_origin,
+    const ignition::math::Vector3d &_spacing)
+{
+  this->size[0] = std::max(_nx, 0);
+  this->size[1] = std::max(_ny, 0);
+  this->size[2] = std::max(_nz, 0);
+  this->origin = _origin;
+  this->invSpacing.Set(
+      _spacing.X() > 0.0 ? 1.0 / _spacing.X() : 0.0,
+      _spacing.Y() > 0.0 ? 1.0 / _spacing.Y() : 0.0,
+      _spacing.Z() > 0.0 ? 1.0 / _spacing.Z() : 0.0);
+
+  // round up to whole tiles
+  this->tiles[0] = (this->size[0] + kTile - 1) / kTile;
+  this->tiles[1] = (this->size[1] + kTile - 1) / kTile;
+  const int tilesZ = (this->size[2] + kTile - 1) / kTile;
+  this->data.assign(static_cast<size_t>(this->tiles[0]) * this->tiles[1] *
+      tilesZ * kTile * kTile * kTile * 3, 0.0f);
+}
+
+/////////////////////////////////////////////////
+size_t WindGrid::Index(const int _i, const int _j, const int _k) const
+{
+  const size_t tile = (static_cast<size_t>(_k / kTile) * this->tiles[1] +
+      _j / kTile) * this->tiles[0] + _i / kTile;
+  const size_t node = ((_k % kTile) * kTile + _j % kTile) * kTile +
+    _i % kTile;
+  return (tile * kTile * kTile * kTile + node) * 3;
+}
+
+/////////////////////////////////////////////////
+void WindGrid::Set(const int _i, const int _j, const int _k,
+    const ignition::math::Vector3d &_v)
+{
+  float *node = &this->data[this->Index(_i, _j, _k)];
+  node[0] = static_cast<float>(_v.X());
+  node[1] = static_cast<float>(_v.Y());
+  node[2] = static_cast<float>(_v.Z());
+}
+
+/////////////////////////////////////////////////
+ignition::math::Vector3d WindGrid::Node(const int _i, const int _j,
+    const int _k) const
+{
+  const float *node = &this->data[this->Index(_i, _j, _k)];
+  return ignition::math::Vector3d(node[0], node[1], node[2]);
+}
+
+/////////////////////////////////////////////////
+bool WindGrid::Empty() const
+{
+  return this->data.empty();
+}
+
+/////////////////////////////////////////////////
+ignition::math::Vector3d WindGrid::Sample(
+    const ignition::math::Vector3d &_pos, const bool _wrap) const
+{
+  if (this->data.empty())
+  {
+    return ignition::math::Vector3d::Zero;
+  }
+
+  // per axis: lower node, upper node and weight of the upper node
+  int lo[3];
+  int hi[3];
+  double t[3];
+  for (int a = 0; a < 3; ++a)
+  {
+    const int n = this->size[a];
+    double x = (_pos[a] - this->origin[a]) * this->invSpacing[a];
+    if (_wrap)
+    {
+      x -= std::floor(x / n) * n;
+      lo[a] = std::min(static_cast<int>(x), n - 1);
+      hi[a] = (lo[a] + 1) % n;
+    }
+    else
+    {
+      x = std::max(0.0, std::min(x, n - 1.0));
+      lo[a] = std::min(static_cast<int>(x), std::max(n - 2, 0));
+      hi[a] = std::min(lo[a] + 1, n - 1);
+    }
+    t[a] = x - lo[a];
+  }
+
+  ignition::math::Vector3d v;
+  for (int c = 0; c < 8; ++c)
+  {
+    const int i = (c & 1) ? hi[0] : lo[0];
+    const int j = (c & 2) ? hi[1] : lo[1];
+    const int k = (c & 4) ? hi[2] : lo[2];
+    const double w = ((c & 1) ? t[0] : 1.0 - t[0]) *
+      ((c & 2) ? t[1] : 1.0 - t[1]) * ((c & 4) ? t[2] : 1.0 - t[2]);
+    v += this->Node(i, j, k) * w;
+  }
+  return v;
+}
+
+/////////////////////////////////////////////////
+ignition::math::Vector3d WindField::Velocity(
+    const ignition::math::Vector3d &_pos, const double _time) const
+{
+  ignition::math::Vector3d v = this->mean.Sample(_pos, false);
+  if (!this->turbulence.Empty())
+  {
+    v += this->turbulence.Sample(_pos - this->advection * _time, true);
+  }
+  return v;
+}
+
+/////////////////////////////////////////////////
+std::shared_ptr<const WindField> WindField::Find(const std::string &_world)
+{
+  std::lock_guard<std::mutex> lock(registryMutex);
+  const auto it = registry.find(_world);
+  return it == registry.end() ? nullptr : it->second.lock();
+}
+
+/// \brief Private data class
+class gazebo::WindFieldPluginPrivate
+{
+  /// \brief Build the mean wind from the power law.
+  /// \param[in] _sdf Plugin element.
+  public: void SynthesizeMean(sdf::ElementPtr _sdf);
+
+  /// \brief Read the mean wind from a file.
+  /// \param[in] _path File path.
+  /// \return False if the file cannot be read.
+  public: bool ReadMean(const std::string &_path);
+
+  /// \brief Build the turbulence tile.
+  /// \param[in] _sdf Plugin element.
+  public: void SynthesizeTurbulence(sdf::ElementPtr _sdf);
+
+  /// \brief World name the field is registered under
+  public: std::string worldName;
+
+  /// \brief The field
+  public: std::shared_ptr<WindField> field;
+};
+
+/////////////////////////////////////////////////
+void WindFieldPluginPrivate::SynthesizeMean(sdf::ElementPtr _sdf)
+{
+  const ignition::math::Vector3d mean =
+    _sdf->Get("mean", ignition::math::Vector3d::Zero).first;
+  const double zRef = std::max(0.1,
+      _sdf->Get("reference_height", 10.0).first);
+  const double alpha = _sdf->Get("shear_exponent", 0.14).first;
+  const ignition::math::Vector3d lo =
+    _sdf->Get("min", ignition::math::Vector3d(-500, -500, 0)).first;
+  const ignition::math::Vector3d hi =
+    _sdf->Get("max", ignition::math::Vector3d(500, 500, 200)).first;
+  const double spacing = std::max(0.1, _sdf->Get("spacing", 10.0).first);
+
+  int n[3];
+  for (int a = 0; a < 3; ++a)
+  {
+    n[a] = std::max(1, static_cast<int>(
+          std::ceil((hi[a] - lo[a]) / spacing)) + 1);
+  }
+  WindGrid &grid = this->field->mean;
+  grid.Resize(n[0], n[1], n[2], lo,
+      ignition::math::Vector3d(spacing, spacing, spacing));
+  for (int k = 0; k < n[2]; ++k)
+  {
+    // shear only depends on height, clamp close to the ground
+    const double z = std::max(0.1, lo.Z() + k * spacing);
+    const ignition::math::Vector3d v = mean * std::pow(z / zRef, alpha);
+    for (int j = 0; j < n[1]; ++j)
+    {
+      for (int i = 0; i < n[0]; ++i)
+      {
+        grid.Set(i, j, k, v);
+      }
+    }
+  }
+  this->field->advection = mean;
+}
+
+/////////////////////////////////////////////////
+bool WindFieldPluginPrivate::ReadMean(const std::string &_path)
+{
+  std::ifstream file(_path);
+  int n[3];
+  ignition::math::Vector3d origin;
+  ignition::math::Vector3d spacing;
+  if (!(file >> n[0] >> n[1] >> n[2] >> origin >> spacing) ||
+      n[0] < 1 || n[1] < 1 || n[2] < 1)
+  {
+    return false;
+  }
+
+  WindGrid &grid = this->field->mean;
+  grid.Resize(n[0], n[1], n[2], origin, spacing);
+  ignition::math::Vector3d sum;
+  for (int k = 0; k < n[2]; ++k)
+  {
+    for (int j = 0; j < n[1]; ++j)
+    {
+      for (int i = 0; i < n[0]; ++i)
+      {
+        ignition::math::Vector3d v;
+        if (!(file >> v))
+        {
+          return false;
+        }
+        grid.Set(i, j, k, v);
+        sum += v;
+      }
+    }
+  }
+  // turbulence is carried with the average wind
+  this->field->advection = sum / (static_cast<double>(n[0]) * n[1] * n[2]);
+  return true;
+}
+
+/////////////////////////////////////////////////
+void WindFieldPluginPrivate::SynthesizeTurbulence(sdf::ElementPtr _sdf)
+{
+  const double intensity = _sdf->Get("turbulence_intensity", 0.0).first;
+  if (intensity <= 0.0)
+  {
+    return;
+  }
+  const double scale = std::max(0.1,
+      _sdf->Get("turbulence_scale", 20.0).first);
+  const int n = std::max(4, _sdf->Get("turbulence_size", 32).first);
+  // own generator, reseeding ignition's would make every sensor noise
+  // model of the world repeat from run to run
+  std::mt19937 generator(_sdf->Get("seed", 1u).first);
+  std::normal_distribution<double> gaussian(0.0, 1.0);
+
+  // white noise, smoothed by periodic box filters along each axis
+  const size_t count = static_cast<size_t>(n) * n * n;
+  std::vector<ignition::math::Vector3d> noise(count);
+  for (auto &v : noise)
+  {
+    const double x = gaussian(generator);
+    const double y = gaussian(generator);
+    v.Set(x, y, gaussian(generator));
+  }
+  const size_t stride[3] = {1, static_cast<size_t>(n),
+    static_cast<size_t>(n) * n};
+  std::vector<ignition::math::Vector3d> smooth(count);
+  for (int pass = 0; pass < 2; ++pass)
+  {
+    for (int a = 0; a < 3; ++a)
+    {
+      for (size_t idx = 0; idx < count; ++idx)
+      {
+        const int c = static_cast<int>(idx / stride[a]) % n;
+        const size_t base = idx - c * stride[a];
+        smooth[idx] = (noise[base + ((c + n - 1) % n) * stride[a]] +
+            noise[idx] + noise[base + ((c + 1) % n) * stride[a]]) / 3.0;
+      }
+      noise.swap(smooth);
+    }
+  }
+
+  // scale to the requested standard deviation
+  double sumSq = 0.0;
+  for (const auto &v : noise)
+  {
+    sumSq += v.SquaredLength();
+  }
+  const double gain = intensity / std::sqrt(sumSq / (3.0 * count));
+
+  WindGrid &grid = this->field->turbulence;
+  grid.Resize(n, n, n, ignition::math::Vector3d::Zero,
+      ignition::math::Vector3d(scale, scale, scale));
+  for (int k = 0; k < n; ++k)
+  {
+    for (int j = 0; j < n; ++j)
+    {
+      for (int i = 0; i < n; ++i)
+      {
+        grid.Set(i, j, k,
+            noise[k * stride[2] + j * stride[1] + i] * gain);
+      }
+    }
+  }
+}
+
+/////////////////////////////////////////////////
+WindFieldPlugin::WindFieldPlugin()
+  : dataPtr(new WindFieldPluginPrivate)
+{
+}
+
+/////////////////////////////////////////////////
+WindFieldPlugin::~WindFieldPlugin()
+{
+  std::lock_guard<std::mutex> lock(registryMutex);
+  const auto it = registry.find(this->dataPtr->worldName);
+  if (it != registry.end() && it->second.lock() == this->dataPtr->field)
+  {
+    registry.erase(it);
+  }
+}
+
+/////////////////////////////////////////////////
+void WindFieldPlugin::Load(physics::WorldPtr _world, sdf::ElementPtr _sdf)
+{
+  GZ_ASSERT(_world, "WindFieldPlugin _world pointer is null");
+  GZ_ASSERT(_sdf, "WindFieldPlugin _sdf pointer is null");
+
+  this->dataPtr->worldName = _world->Name();
+  this->dataPtr->field = std::make_shared<WindField>();
+
+  const std::string path = _sdf->Get("file", std::string()).first;
+  if (path.empty())
+  {
+    this->dataPtr->SynthesizeMean(_sdf);
+  }
+  else if (!this->dataPtr->ReadMean(path))
+  {
+    gzerr << "[" << this->dataPtr->worldName << "] "
+          << "failed to read wind file [" << path
+          << "], using the power law.\n";
+    this->dataPtr->SynthesizeMean(_sdf);
+  }
+  this->dataPtr->SynthesizeTurbulence(_sdf);
+
+  const WindGrid &mean = this->dataPtr->field->mean;
+  gzmsg << "[" << this->dataPtr->worldName << "] "
+        << "wind field " << mean.size[0] << "x" << mean.size[1] << "x"
+        << mean.size[2] << (this->dataPtr->field->turbulence.Empty() ?
+            "" : " with turbulence") << ".\n";
+
+  std::lock_guard<std::mutex> lock(registryMutex);
+  registry[this->dataPtr->worldName] = this->dataPtr->field;
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2026 ardupilot_sitl_gazebo contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+// Loopback test of the shared memory transport: the simulator end
+// (ArduPilotShm) and the SITL end (libArduPilotShmPeer) exchange a servo
+// and a state packet in one process, then the receive timeout is
+// checked.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "include/ArduPilotShm.hh"
+#include "include/ArduPilotShmPeer.hh"
+
+/// \brief Report a failed check and return from main.
+#define CHECK(_cond) \
+  do \
+  { \
+    if (!(_cond)) \
+    { \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+          #_cond); \
+      return 1; \
+    } \
+  } while (0)
+
+/////////////////////////////////////////////////
+int main()
+{
+  const std::string name =
+    "/ardupilot_shm_loopback_" + std::to_string(getpid());
+
+  gazebo::ArduPilotShm sim;
+  CHECK(sim.Create(name));
+  CHECK(sim.IsOpen());
+
+  // a second simulator must not take over a live segment
+  gazebo::ArduPilotShm other;
+  CHECK(!other.Create(name));
+
+  ap_shm_peer *peer = ap_shm_peer_open(name.c_str());
+  CHECK(peer != nullptr);
+
+  // servo packet, SITL to Gazebo
+  const float servo[4] = {0.1f, 0.2f, 0.3f, 0.4f};
+  CHECK(ap_shm_peer_send_servo(peer, servo, sizeof(servo)) ==
+      static_cast<int>(sizeof(servo)));
+  float servoIn[16] = {};
+  uint32_t dropped = 0;
+  CHECK(sim.RecvLatest(servoIn, sizeof(servoIn), 100, dropped) ==
+      static_cast<ssize_t>(sizeof(servo)));
+  CHECK(dropped == 0);
+  CHECK(memcmp(servo, servoIn, sizeof(servo)) == 0);
+
+  // state packet, Gazebo to SITL
+  const double state[8] = {1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0};
+  CHECK(sim.Send(state, sizeof(state)) ==
+      static_cast<ssize_t>(sizeof(state)));
+  double stateIn[32] = {};
+  CHECK(ap_shm_peer_recv_state(peer, stateIn, sizeof(stateIn), 100) ==
+      static_cast<int>(sizeof(state)));
+  CHECK(memcmp(state, stateIn, sizeof(state)) == 0);
+
+  // only the newest of several unread packets is returned
+  for (int i = 0; i < 3; ++i)
+  {
+    const float value[1] = {static_cast<float>(i)};
+    CHECK(ap_shm_peer_send_servo(peer, value, sizeof(value)) > 0);
+  }
+  CHECK(sim.RecvLatest(servoIn, sizeof(servoIn), 100, dropped) ==
+      static_cast<ssize_t>(sizeof(float)));
+  CHECK(dropped == 2);
+  CHECK(servoIn[0] > 1.5f);
+
+  // nothing new: both ends time out
+  CHECK(sim.RecvLatest(servoIn, sizeof(servoIn), 20, dropped) == -1);
+  CHECK(sim.WaitStats().timeouts == 1);
+  // a zero timeout probe is not a timeout
+  CHECK(sim.RecvLatest(servoIn, sizeof(servoIn), 0, dropped) == -1);
+  CHECK(sim.WaitStats().timeouts == 1);
+  CHECK(ap_shm_peer_recv_state(peer, stateIn, sizeof(stateIn), 20) == -1);
+
+  ap_shm_peer_close(peer);
+
+  // a segment left behind by a simulator that died is replaced
+  const std::string stale = name + "_stale";
+  const pid_t child = fork();
+  CHECK(child >= 0);
+  if (child == 0)
+  {
+    // exit without the destructor, like a crash
+    gazebo::ArduPilotShm crashed;
+    _exit(crashed.Create(stale) ? 0 : 1);
+  }
+  int status = 0;
+  CHECK(waitpid(child, &status, 0) == child);
+  CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  gazebo::ArduPilotShm replacement;
+  CHECK(replacement.Create(stale));
+
+  // a segment still being set up by its creator is left alone
+  const std::string starting = name + "_starting";
+  const int fd = shm_open(starting.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  CHECK(fd >= 0);
+  close(fd);
+  gazebo::ArduPilotShm late;
+  const bool tookOver = late.Create(starting);
+  shm_unlink(starting.c_str());
+  CHECK(!tookOver);
+
+  printf("shm loopback ok\n");
+  return 0;
+}
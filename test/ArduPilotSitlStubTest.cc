@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2026 ardupilot_sitl_gazebo contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+// Test of the in-process transport: loads the stub flight stack, steps
+// it with a state packet and checks its constant servo command comes
+// back. Usage: ArduPilotSitlStubTest <path to libArduPilotSitlStub>
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#include "include/ArduPilotTransport.hh"
+
+/// \brief Report a failed check and return from main.
+#define CHECK(_cond) \
+  do \
+  { \
+    if (!(_cond)) \
+    { \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+          #_cond); \
+      return 1; \
+    } \
+  } while (0)
+
+/////////////////////////////////////////////////
+int main(int _argc, char **_argv)
+{
+  CHECK(_argc == 2);
+
+  std::unique_ptr<gazebo::ArduPilotTransport> transport =
+    gazebo::ArduPilotTransport::Create("inprocess");
+  CHECK(transport != nullptr);
+  CHECK(!transport->SupportsWakeFd());
+  CHECK(transport->Bind(_argv[1], 0));
+  CHECK(transport->Connect("channels=4 throttle=0.5", 0));
+
+  // initial command, before any state was sent
+  float servo[16] = {};
+  uint32_t dropped = 0;
+  CHECK(transport->RecvLatest(servo, sizeof(servo), 0, dropped) ==
+      static_cast<ssize_t>(4 * sizeof(float)));
+  CHECK(dropped == 0);
+
+  // one step
+  const double state[17] = {0.001};
+  CHECK(transport->Send(state, sizeof(state)) ==
+      static_cast<ssize_t>(sizeof(state)));
+  memset(servo, 0, sizeof(servo));
+  CHECK(transport->RecvLatest(servo, sizeof(servo), 0, dropped) ==
+      static_cast<ssize_t>(4 * sizeof(float)));
+  for (int i = 0; i < 4; ++i)
+  {
+    CHECK(servo[i] > 0.49f && servo[i] < 0.51f);
+  }
+  CHECK(servo[4] < 0.01f && servo[4] > -0.01f);
+
+  // a short buffer gets the packet truncated
+  float one[1] = {};
+  CHECK(transport->Send(state, sizeof(state)) > 0);
+  CHECK(transport->RecvLatest(one, sizeof(one), 0, dropped) ==
+      static_cast<ssize_t>(sizeof(one)));
+  CHECK(one[0] > 0.49f && one[0] < 0.51f);
+
+  // a failed step is reported by Send
+  std::unique_ptr<gazebo::ArduPilotTransport> stopping =
+    gazebo::ArduPilotTransport::Create("inprocess");
+  CHECK(stopping->Bind(_argv[1], 0));
+  CHECK(stopping->Connect("steps=1", 0));
+  CHECK(stopping->Send(state, sizeof(state)) > 0);
+  CHECK(stopping->RecvLatest(servo, sizeof(servo), 0, dropped) > 0);
+  CHECK(stopping->Send(state, sizeof(state)) == -1);
+  CHECK(stopping->RecvLatest(servo, sizeof(servo), 0, dropped) == -1);
+
+  // a library that is not a flight stack is refused
+  std::unique_ptr<gazebo::ArduPilotTransport> missing =
+    gazebo::ArduPilotTransport::Create("inprocess");
+  CHECK(!missing->Bind("libArduPilotSitlMissing.so", 0));
+
+  printf("in-process stub ok\n");
+  return 0;
+}
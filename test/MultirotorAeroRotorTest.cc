@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2026 ardupilot_sitl_gazebo contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+// Thrust direction of the MultirotorAeroPlugin rotors: a rotor turning
+// its intended way pushes along its joint axis whatever its direction.
+
+#include <cstdio>
+
+#include "include/MultirotorAeroRotor.hh"
+
+/// \brief Report a failed check and return from main.
+#define CHECK(_cond) \
+  do \
+  { \
+    if (!(_cond)) \
+    { \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+          #_cond); \
+      return 1; \
+    } \
+  } while (0)
+
+/////////////////////////////////////////////////
+int main()
+{
+  const double ccw = 1.0;
+  const double cw = -1.0;
+
+  // intended spin, thrust along +axis
+  CHECK(gazebo::RotorThrustSense(ccw, 838.0) > 0.0);
+  CHECK(gazebo::RotorThrustSense(cw, -838.0) > 0.0);
+
+  // reversed spin, thrust against the axis
+  CHECK(gazebo::RotorThrustSense(ccw, -838.0) < 0.0);
+  CHECK(gazebo::RotorThrustSense(cw, 838.0) < 0.0);
+
+  printf("rotor thrust sense ok\n");
+  return 0;
+}